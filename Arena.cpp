@@ -0,0 +1,47 @@
+#include "Arena.h"
+
+#include <cstring>
+#include <algorithm>
+
+Arena::Arena(size_t blockSize) :current(0), offset(0), blockSize(blockSize) {
+}
+
+Arena::~Arena() {
+    for(auto &i : blocks) {
+        delete[] i.data;
+    }
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    while(current < blocks.size()) {
+        Block& block = blocks[current];
+        size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+        if(aligned + size <= block.size) {
+            offset = aligned + size;
+            return block.data + aligned;
+        }
+        current++;
+        offset = 0;
+    }
+
+    // Out of blocks, only happens while the arena grows to its working size. Each new block
+    // is at least twice the largest so far, so requests that creep up a little on every
+    // compilation add a logarithmic number of blocks rather than one each. new[] memory is
+    // aligned for any fundamental type, so the new block's offset 0 is always aligned
+    size_t newSize = std::max(size, blocks.empty() ? blockSize : blocks.back().size * 2);
+    Block block = {new char[newSize], newSize};
+    blocks.push_back(block);
+    current = blocks.size() - 1;
+    offset = size;
+    return block.data;
+}
+
+size_t Arena::getBlockCount() const {
+    return blocks.size();
+}
+
+std::string_view Arena::copy(std::string_view text) {
+    char* data = static_cast<char*>(allocate(text.size(), 1));
+    std::memcpy(data, text.data(), text.size());
+    return std::string_view(data, text.size());
+}
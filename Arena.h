@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <string_view>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// Bump allocator for data that lives for one compilation. Memory comes from a list of
+// blocks that is kept across reset(), so once the blocks have grown to fit the largest
+// compilation seen, allocating from the arena never touches the global heap.
+class Arena {
+    public:
+    Arena(size_t blockSize = 64 * 1024);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+
+    // Objects are never destroyed, only trivially destructible types belong here
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copies text into the arena, the view is valid until reset()
+    std::string_view copy(std::string_view text);
+
+    // Releases everything allocated since the last reset in O(1), keeping the blocks
+    void reset() {
+        current = 0;
+        offset = 0;
+    }
+
+    // Blocks held, each at least twice the size of the one before
+    size_t getBlockCount() const;
+
+    private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current;
+    size_t offset;
+    size_t blockSize;
+};
+
+// Lets standard containers allocate from an Arena, deallocation is a no-op
+template<typename T>
+class ArenaAllocator {
+    public:
+    typedef T value_type;
+
+    ArenaAllocator(Arena& arena) :arena(&arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) :arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return arena != other.arena;
+    }
+
+    Arena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,21 @@
+#include "Ast.h"
+
+int Ast::add(const AstNode& node) {
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+int Ast::addName(std::string_view name) {
+    for(int i = 0; i < names.size(); ++i) {
+        if(names[i] == name) {
+            return i;
+        }
+    }
+    names.push_back(std::string(name));
+    return names.size() - 1;
+}
+
+void Ast::clear() {
+    nodes.clear();
+    names.clear();
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+
+// Expression tree node, children are indices of nodes in the same Ast
+struct AstNode {
+    enum Kind {
+        NODE_NUMBER = 0,    // value
+        NODE_VARIABLE,      // id is the name index
+        NODE_NEGATE,        // -children[0]
+        NODE_BINARY,        // id is the Instruction::Operation of children[0], children[1]
+        NODE_CALL,          // id is the function id, one child per argument
+        NODE_ASSIGN         // variable children[0] = children[1]
+    };
+
+    int kind;
+    int id;
+    double value;
+    // Index of the source token, for error reporting
+    int token;
+    int childCount;
+    int children[3];
+};
+
+// Owns the nodes of one parsed line. Nodes live in a single array and refer to each
+// other by index, so building a tree is a push_back and clearing it keeps the capacity
+class Ast {
+    public:
+    int add(const AstNode& node);
+    int addName(std::string_view name);
+    void clear();
+
+    const AstNode& get(int index) const {
+        return nodes[index];
+    }
+    AstNode& get(int index) {
+        return nodes[index];
+    }
+    const std::string& getName(int index) const {
+        return names[index];
+    }
+    int size() const {
+        return nodes.size();
+    }
+
+    private:
+    std::vector<AstNode> nodes;
+    std::vector<std::string> names;
+};
@@ -0,0 +1,247 @@
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+#include "AstParser.h"
+#include "Ast.h"
+#include "Token.h"
+#include "TokenList.h"
+#include "Parser.h"
+#include "Calculator.h"
+#include "Constants.h"
+#include "Functions.h"
+#include "Instruction.h"
+
+AstParser::AstParser(Calculator* calculator) : calculator(calculator) {
+}
+
+// Prefix minus binds below '^' and above everything else, -x^2 is -(x^2)
+static bool negateBindsOver(int precedence) {
+    return precedence < Parser::getPrecedence('^');
+}
+
+// Whether the minus ending token is written against a number, "-2" rather than "- 2" or "-x"
+static bool negatesLiteral(const TokenList& tokens, int token) {
+    const auto& list = tokens.list;
+    return token + 1 < list.size() && list[token + 1].isType(Token::TOKEN_NUMBER) &&
+        list[token + 1].getOffset() == list[token].getOffset() + list[token].getLength();
+}
+
+int AstParser::fail(const TokenList& tokens, int token, const char* message) {
+    Token errorToken = token >= 0 ? tokens.list[token] : Token(Token::TOKEN_EXPRESSION, 0, tokens.source.size());
+    calculator->reportError(errorToken, tokens.source, message);
+    return -1;
+}
+
+bool AstParser::reduce(const TokenList& tokens, Ast& ast) {
+    Frame frame = frames.back();
+    frames.pop_back();
+
+    if(frame.kind == Frame::FRAME_NEGATE) {
+        AstNode& operand = ast.get(operands.back());
+        if(operand.kind == AstNode::NODE_NUMBER) {
+            // Negative literals stay literals, -2 is a constant not a multiplication
+            operand.value = -operand.value;
+        } else {
+            operands.back() = ast.add({AstNode::NODE_NEGATE, 0, 0., frame.token, 1, {operands.back(), 0, 0}});
+        }
+        return true;
+    }
+
+    int b = operands.back();
+    operands.pop_back();
+    int a = operands.back();
+
+    if(frame.symbol == '=') {
+        if(ast.get(a).kind != AstNode::NODE_VARIABLE) {
+            fail(tokens, frame.token, "Invalid Assignment, left hand side must be a variable");
+            return false;
+        }
+        operands.back() = ast.add({AstNode::NODE_ASSIGN, 0, 0., frame.token, 2, {a, b, 0}});
+    } else {
+        operands.back() = ast.add({AstNode::NODE_BINARY, Instruction::operationFromOperator(frame.symbol), 0., frame.token, 2, {a, b, 0}});
+    }
+    return true;
+}
+
+bool AstParser::finishCall(const TokenList& tokens, Ast& ast) {
+    Frame frame = frames.back();
+    frames.pop_back();
+
+    int argumentCount = operands.size() - frame.operandBase;
+    const FunctionDefinition_t& definition = Functions::get(frame.functionId);
+    if(argumentCount != definition.arity) {
+        fail(tokens, frame.token, argumentCount > definition.arity ? "Too Many parameters." : "Too Few parameters.");
+        return false;
+    }
+
+    AstNode node = {AstNode::NODE_CALL, frame.functionId, 0., frame.token, argumentCount, {0, 0, 0}};
+    std::copy(operands.end() - argumentCount, operands.end(), node.children);
+    operands.resize(frame.operandBase);
+    operands.push_back(ast.add(node));
+    return true;
+}
+
+int AstParser::parse(const TokenList& tokens, Ast& ast) {
+    operands.clear();
+    frames.clear();
+
+    const auto& list = tokens.list;
+    bool expectOperand = true;
+    // Set by a minus written against the number that follows, which it becomes part of
+    bool negativeLiteral = false;
+
+    for(int i = 0; i < list.size(); ++i) {
+        const Token& token = list[i];
+        int type = token.getType();
+        if(type == Token::TOKEN_WHITESPACE || type == Token::TOKEN_SEMICOLON) {
+            continue;
+        }
+
+        if(expectOperand) {
+            if(type == Token::TOKEN_NUMBER) {
+                double value = token.getNumber();
+                if(std::isnan(value)) {
+                    return fail(tokens, i, "Invalid Number");
+                }
+                if(negativeLiteral) {
+                    // The literal is negative before any operator applies, -2^2 is 4
+                    value = -value;
+                    negativeLiteral = false;
+                }
+                operands.push_back(ast.add({AstNode::NODE_NUMBER, 0, value, i, 0, {0, 0, 0}}));
+                expectOperand = false;
+            } else if(type == Token::TOKEN_IDENTIFIER) {
+                std::string_view name = tokens.getValue(token);
+                int next = i + 1;
+                while(next < list.size() && list[next].isType(Token::TOKEN_WHITESPACE)) {
+                    next++;
+                }
+
+                if(next < list.size() && list[next].isType(Token::TOKEN_OPEN_PARENTHESIS)) {
+                    int functionId = Functions::find(name);
+                    if(functionId < 0) {
+                        return fail(tokens, i, "Unknown function");
+                    }
+                    frames.push_back({Frame::FRAME_CALL, 0, functionId, i, (int)operands.size()});
+                    i = next;
+                    continue;
+                }
+
+                if(Constants::exists(name)) {
+                    operands.push_back(ast.add({AstNode::NODE_NUMBER, 0, Constants::get(name), i, 0, {0, 0, 0}}));
+                } else if(Functions::exists(name)) {
+                    return fail(tokens, i, "Missing function body");
+                } else {
+                    operands.push_back(ast.add({AstNode::NODE_VARIABLE, ast.addName(name), 0., i, 0, {0, 0, 0}}));
+                }
+                expectOperand = false;
+            } else if(type == Token::TOKEN_OPERATOR) {
+                // Operator runs like "+-" arrive as one token
+                std::string_view value = tokens.getValue(token);
+                for(int c = 0; c < value.size(); ++c) {
+                    if(value[c] == '-' && c == value.size() - 1 && negatesLiteral(tokens, i)) {
+                        negativeLiteral = true;
+                    } else if(value[c] == '-') {
+                        frames.push_back({Frame::FRAME_NEGATE, '-', 0, i, 0});
+                    } else if(value[c] != '+') {
+                        return fail(tokens, i, "Unexpected operator");
+                    }
+                }
+            } else if(type == Token::TOKEN_OPEN_PARENTHESIS) {
+                frames.push_back({Frame::FRAME_PARENTHESIS, '(', 0, i, 0});
+            } else if(type == Token::TOKEN_CLOSE_PARENTHESIS && !frames.empty() && frames.back().kind == Frame::FRAME_CALL && frames.back().operandBase == operands.size()) {
+                // A call with no arguments, reported by the arity check
+                if(!finishCall(tokens, ast)) {
+                    return -1;
+                }
+                expectOperand = false;
+            } else if((type == Token::TOKEN_COMMA || type == Token::TOKEN_CLOSE_PARENTHESIS) && !frames.empty() && frames.back().kind == Frame::FRAME_CALL) {
+                return fail(tokens, frames.back().token, "Empty parameter");
+            } else if(type == Token::TOKEN_COMMA) {
+                return fail(tokens, i, "Unexpected comma");
+            } else {
+                return fail(tokens, i, "Incomplete expression");
+            }
+            continue;
+        }
+
+        if(type == Token::TOKEN_OPERATOR) {
+            std::string_view value = tokens.getValue(token);
+            char symbol = value[0];
+            int precedence = Parser::getPrecedence(symbol);
+            if(precedence < 0) {
+                return fail(tokens, i, "Invalid Operator");
+            }
+            // Assignment is right associative, everything else groups left
+            bool rightAssociative = symbol == '=';
+            while(!frames.empty()) {
+                const Frame& top = frames.back();
+                bool tighter = (top.kind == Frame::FRAME_NEGATE && negateBindsOver(precedence)) ||
+                    (top.kind == Frame::FRAME_OPERATOR && (Parser::getPrecedence(top.symbol) > precedence || (Parser::getPrecedence(top.symbol) == precedence && !rightAssociative)));
+                if(!tighter) {
+                    break;
+                }
+                if(!reduce(tokens, ast)) {
+                    return -1;
+                }
+            }
+            frames.push_back({Frame::FRAME_OPERATOR, symbol, 0, i, 0});
+
+            // Anything after the first character of a run is a prefix, "2*-x"
+            for(int c = 1; c < value.size(); ++c) {
+                if(value[c] == '-' && c == value.size() - 1 && negatesLiteral(tokens, i)) {
+                    negativeLiteral = true;
+                } else if(value[c] == '-') {
+                    frames.push_back({Frame::FRAME_NEGATE, '-', 0, i, 0});
+                } else if(value[c] != '+') {
+                    return fail(tokens, i, "Unexpected operator");
+                }
+            }
+            expectOperand = true;
+        } else if(type == Token::TOKEN_COMMA || type == Token::TOKEN_CLOSE_PARENTHESIS) {
+            while(!frames.empty() && (frames.back().kind == Frame::FRAME_OPERATOR || frames.back().kind == Frame::FRAME_NEGATE)) {
+                if(!reduce(tokens, ast)) {
+                    return -1;
+                }
+            }
+
+            if(type == Token::TOKEN_COMMA) {
+                if(frames.empty() || frames.back().kind != Frame::FRAME_CALL) {
+                    return fail(tokens, i, "Unexpected comma");
+                }
+                expectOperand = true;
+            } else if(frames.empty()) {
+                return fail(tokens, i, "Mismatched Parentheses");
+            } else if(frames.back().kind == Frame::FRAME_PARENTHESIS) {
+                frames.pop_back();
+            } else if(!finishCall(tokens, ast)) {
+                return -1;
+            }
+        } else if(type == Token::TOKEN_NUMBER) {
+            return fail(tokens, i, "Unexpected number");
+        } else if(type == Token::TOKEN_IDENTIFIER) {
+            return fail(tokens, i, "Unexpected identifier");
+        } else {
+            return fail(tokens, i, "Unexpected token");
+        }
+    }
+
+    if(expectOperand) {
+        if(operands.empty() && frames.empty()) {
+            return -1;
+        }
+        return fail(tokens, -1, "Incomplete expression");
+    }
+
+    while(!frames.empty()) {
+        if(frames.back().kind == Frame::FRAME_PARENTHESIS || frames.back().kind == Frame::FRAME_CALL) {
+            return fail(tokens, frames.back().token, "Mismatched Parentheses");
+        }
+        if(!reduce(tokens, ast)) {
+            return -1;
+        }
+    }
+
+    return operands.back();
+}
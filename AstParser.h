@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+
+class Ast;
+class TokenList;
+class Calculator;
+
+// Builds an Ast from the tokens of one line in a single left to right pass.
+// Operators and open calls are kept on explicit stacks rather than the C++ stack,
+// so nesting depth is bounded only by memory.
+class AstParser {
+    public:
+    AstParser(Calculator* calculator);
+
+    // Returns the root node, or -1 if the line is empty or has errors (which are reported)
+    int parse(const TokenList& tokens, Ast& ast);
+
+    private:
+    struct Frame {
+        enum Kind {
+            FRAME_OPERATOR = 0, // binary operator, symbol is the operator character
+            FRAME_NEGATE,       // prefix minus, binds tighter than any binary operator but '^'
+            FRAME_PARENTHESIS,
+            FRAME_CALL          // function call, operandBase is the operand count at its '('
+        };
+        int kind;
+        char symbol;
+        int functionId;
+        int token;
+        int operandBase;
+    };
+
+    bool reduce(const TokenList& tokens, Ast& ast);
+    bool finishCall(const TokenList& tokens, Ast& ast);
+    int fail(const TokenList& tokens, int token, const char* message);
+
+    Calculator* calculator;
+    // Reused between lines
+    std::vector<int> operands;
+    std::vector<Frame> frames;
+};
@@ -0,0 +1,227 @@
+#include <math.h>
+#include <cstdlib>
+#include <new>
+
+#include "BatchVM.h"
+#include "Instruction.h"
+#include "InstructionVM.h"
+#include "Functions.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+typedef __m256d Vector;
+static const int vectorWidth = 4;
+static inline Vector loadVector(const double* p) { return _mm256_load_pd(p); }
+static inline void storeVector(double* p, Vector v) { _mm256_store_pd(p, v); }
+static inline Vector broadcastVector(double v) { return _mm256_set1_pd(v); }
+static inline Vector addVector(Vector a, Vector b) { return _mm256_add_pd(a, b); }
+static inline Vector subVector(Vector a, Vector b) { return _mm256_sub_pd(a, b); }
+static inline Vector mulVector(Vector a, Vector b) { return _mm256_mul_pd(a, b); }
+static inline Vector divVector(Vector a, Vector b) { return _mm256_div_pd(a, b); }
+static inline Vector sqrtVector(Vector a) { return _mm256_sqrt_pd(a); }
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128d Vector;
+static const int vectorWidth = 2;
+static inline Vector loadVector(const double* p) { return _mm_load_pd(p); }
+static inline void storeVector(double* p, Vector v) { _mm_store_pd(p, v); }
+static inline Vector broadcastVector(double v) { return _mm_set1_pd(v); }
+static inline Vector addVector(Vector a, Vector b) { return _mm_add_pd(a, b); }
+static inline Vector subVector(Vector a, Vector b) { return _mm_sub_pd(a, b); }
+static inline Vector mulVector(Vector a, Vector b) { return _mm_mul_pd(a, b); }
+static inline Vector divVector(Vector a, Vector b) { return _mm_div_pd(a, b); }
+static inline Vector sqrtVector(Vector a) { return _mm_sqrt_pd(a); }
+#else
+typedef double Vector;
+static const int vectorWidth = 1;
+static inline Vector loadVector(const double* p) { return *p; }
+static inline void storeVector(double* p, Vector v) { *p = v; }
+static inline Vector broadcastVector(double v) { return v; }
+static inline Vector addVector(Vector a, Vector b) { return a + b; }
+static inline Vector subVector(Vector a, Vector b) { return a - b; }
+static inline Vector mulVector(Vector a, Vector b) { return a * b; }
+static inline Vector divVector(Vector a, Vector b) { return a / b; }
+static inline Vector sqrtVector(Vector a) { return sqrt(a); }
+#endif
+
+// Matches Instruction::multiplyAdd, fused only where the scalar path is fused too
+static inline Vector multiplyAdd(Vector a, Vector b, Vector c) {
+#if defined(FP_FAST_FMA) && defined(__FMA__) && defined(__AVX__)
+    return _mm256_fmadd_pd(a, b, c);
+#elif defined(FP_FAST_FMA) && defined(__FMA__) && defined(__SSE2__)
+    return _mm_fmadd_pd(a, b, c);
+#else
+    return addVector(mulVector(a, b), c);
+#endif
+}
+
+static const size_t blockAlignment = 64;
+
+static double* allocateBlocks(int count) {
+    return static_cast<double*>(::operator new[](sizeof(double) * BatchVM::lanes * count, std::align_val_t(blockAlignment)));
+}
+
+static void freeBlocks(double* blocks) {
+    ::operator delete[](blocks, std::align_val_t(blockAlignment));
+}
+
+// Applies op to each vector of a block, d and the sources point at lanes doubles
+template<typename Op>
+static inline void forEachVector(double* d, const double* a, const double* b, Op op) {
+    for(int l = 0; l < BatchVM::lanes; l += vectorWidth) {
+        storeVector(d + l, op(loadVector(a + l), loadVector(b + l)));
+    }
+}
+
+BatchVM::BatchVM() :registers(nullptr), registerCapacity(0), variables(nullptr), variableCapacity(0), generation(0) {
+}
+
+BatchVM::~BatchVM() {
+    freeBlocks(registers);
+    freeBlocks(variables);
+}
+
+void BatchVM::executeBlock(const std::vector<Instruction>& instructions, int registerCount, int resultRegister,
+    const InstructionVM& vm, int slot, const double* inputs, double* outputs) {
+    if(registerCapacity < registerCount) {
+        freeBlocks(registers);
+        registers = allocateBlocks(registerCount);
+        registerCapacity = registerCount;
+    }
+    int variableCount = vm.getVariableNames().size();
+    if(variableCapacity < variableCount) {
+        freeBlocks(variables);
+        variables = allocateBlocks(variableCount);
+        variableCapacity = variableCount;
+        filled.assign(variableCount, 0);
+    }
+    // Variables are copied into the lanes on their first load rather than all up front,
+    // so a block costs what the program references, not every name the VM has bound
+    generation++;
+
+    double* r = registers;
+    double* v = variables;
+    static const int sqrtId = Functions::find("sqrt");
+
+    for(const auto &i : instructions) {
+        // Stores have no destination register
+        double* d = r + (i.getDst() < 0 ? 0 : i.getDst()) * lanes;
+        const double* a = r + i.getA() * lanes;
+        const double* b = r + i.getB() * lanes;
+        const double* c = r + i.getC() * lanes;
+
+        switch(i.getOperation()) {
+            case Instruction::OP_LOAD_CONSTANT: {
+                Vector k = broadcastVector(i.getOperand().getValue());
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, k);
+                break;
+            }
+            case Instruction::OP_LOAD_VARIABLE:
+                if(filled[i.getA()] != generation) {
+                    filled[i.getA()] = generation;
+                    double* lanesOf = v + i.getA() * lanes;
+                    for(int l = 0; l < lanes; ++l) {
+                        lanesOf[l] = i.getA() == slot ? inputs[l] : vm.getVar(i.getA());
+                    }
+                }
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, loadVector(v + i.getA() * lanes + l));
+                break;
+            case Instruction::OP_STORE_VARIABLE:
+                // Later loads see the stored value rather than the VM's
+                filled[i.getB()] = generation;
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(v + i.getB() * lanes + l, loadVector(a + l));
+                break;
+            case Instruction::OP_ADD:
+                forEachVector(d, a, b, addVector);
+                break;
+            case Instruction::OP_SUB:
+                forEachVector(d, a, b, subVector);
+                break;
+            case Instruction::OP_MUL:
+                forEachVector(d, a, b, mulVector);
+                break;
+            case Instruction::OP_DIV:
+                forEachVector(d, a, b, divVector);
+                break;
+            case Instruction::OP_POW:
+                for(int l = 0; l < lanes; ++l) d[l] = pow(a[l], b[l]);
+                break;
+            case Instruction::OP_MOD:
+                for(int l = 0; l < lanes; ++l) d[l] = fmod(a[l], b[l]);
+                break;
+            case Instruction::OP_CALL1: {
+                int functionId = i.getOperand().getFunctionId();
+                if(functionId == sqrtId) {
+                    for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, sqrtVector(loadVector(a + l)));
+                    break;
+                }
+                Function1_t f = Functions::get(functionId).f1;
+                for(int l = 0; l < lanes; ++l) d[l] = f(a[l]);
+                break;
+            }
+            case Instruction::OP_CALL2: {
+                Function2_t f = Functions::get(i.getOperand().getFunctionId()).f2;
+                for(int l = 0; l < lanes; ++l) d[l] = f(a[l], b[l]);
+                break;
+            }
+            case Instruction::OP_CALL3: {
+                Function3_t f = Functions::get(i.getOperand().getFunctionId()).f3;
+                for(int l = 0; l < lanes; ++l) d[l] = f(a[l], b[l], c[l]);
+                break;
+            }
+            case Instruction::OP_ADDK: {
+                Vector k = broadcastVector(i.getOperand().getValue());
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, addVector(loadVector(a + l), k));
+                break;
+            }
+            case Instruction::OP_SUBK: {
+                Vector k = broadcastVector(i.getOperand().getValue());
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, subVector(loadVector(a + l), k));
+                break;
+            }
+            case Instruction::OP_MULK: {
+                Vector k = broadcastVector(i.getOperand().getValue());
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, mulVector(loadVector(a + l), k));
+                break;
+            }
+            case Instruction::OP_DIVK: {
+                Vector k = broadcastVector(i.getOperand().getValue());
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, divVector(loadVector(a + l), k));
+                break;
+            }
+            case Instruction::OP_POWK: {
+                double k = i.getOperand().getValue();
+                for(int l = 0; l < lanes; ++l) d[l] = pow(a[l], k);
+                break;
+            }
+            case Instruction::OP_MODK: {
+                double k = i.getOperand().getValue();
+                for(int l = 0; l < lanes; ++l) d[l] = fmod(a[l], k);
+                break;
+            }
+            case Instruction::OP_KSUB: {
+                Vector k = broadcastVector(i.getOperand().getValue());
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, subVector(k, loadVector(a + l)));
+                break;
+            }
+            case Instruction::OP_KDIV: {
+                Vector k = broadcastVector(i.getOperand().getValue());
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, divVector(k, loadVector(a + l)));
+                break;
+            }
+            case Instruction::OP_MULADD:
+                for(int l = 0; l < lanes; l += vectorWidth) storeVector(d + l, multiplyAdd(loadVector(a + l), loadVector(b + l), loadVector(c + l)));
+                break;
+            case Instruction::OP_SINCOS: {
+                double* cosines = r + i.getB() * lanes;
+                for(int l = 0; l < lanes; ++l) Functions::sinCos(a[l], d[l], cosines[l]);
+                break;
+            }
+        }
+    }
+
+    const double* result = r + resultRegister * lanes;
+    for(int l = 0; l < lanes; ++l) {
+        outputs[l] = result[l];
+    }
+}
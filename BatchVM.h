@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+class Instruction;
+class InstructionVM;
+
+// Executes a compiled program for a block of inputs at once: every register holds one
+// value per lane and each instruction is applied across all lanes with SSE2/AVX vectors.
+class BatchVM {
+    public:
+    // Doubles evaluated per pass over the bytecode
+    static const int lanes = 8;
+
+    BatchVM();
+    ~BatchVM();
+
+    // Evaluates lanes inputs, with inputs[] bound to variable slot and other variables
+    // taken from vm. Stores only affect the batch, vm's variables are left unchanged.
+    void executeBlock(const std::vector<Instruction>& instructions, int registerCount, int resultRegister,
+        const InstructionVM& vm, int slot, const double* inputs, double* outputs);
+
+    private:
+    double* registers;
+    int registerCapacity;
+    double* variables;
+    int variableCapacity;
+    // Generation of the block that last copied or stored each variable's lanes
+    std::vector<uint64_t> filled;
+    uint64_t generation;
+};
@@ -0,0 +1,378 @@
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+
+#include "Calculator.h"
+#include "Instruction.h"
+#include "InstructionVM.h"
+#include "Program.h"
+#include "ExecutionContext.h"
+#include "ThreadPool.h"
+#include "GraphSampler.h"
+#include "EvaluationWorker.h"
+#include "Parser.h"
+#include "TokenList.h"
+
+// Expressions representative of the graphing and batch workloads
+const std::vector<std::string> corpus = {
+    "x*2+1",
+    "(x+1)*(x-1)/(x*x+1)",
+    "sin(x)*cos(x)+sqrt(abs(x))",
+    "max(x, min(x*x, 0.5)) - clamp(x, -0.25, 0.25)",
+    "2*PI*x + sin(PI/4)",
+    "sin(x)^2 + sin(x)*cos(x)",
+    "scale=.5; v=(sin(x*pi*40) * scale); v2=sin(x*pi*.3); clamp(v+v2,-.25,.25)-v2+(x*1.2)",
+};
+
+// Curves that leave the view or have poles, for graph sampling
+const std::vector<std::string> steepCorpus = {
+    "tan(x*5)",
+    "1/x",
+    "sin(1/x)",
+    "exp(x*8)-2",
+    "x*x*40-3",
+    "floor(x*10)/5",
+};
+
+// Generated formulas that repeat subterms
+const std::vector<std::string> redundantCorpus = {
+    "sin(x)^2 + sin(x)*cos(x) + cos(x)^2",
+    "(x*x+1)/(x*x+2) + sqrt(x*x+1)",
+    "exp(-1*x*x) * sin(2*PI*x) + exp(-1*x*x) * cos(2*PI*x)",
+    "max(sin(x), cos(x)) - min(sin(x), cos(x)) + abs(sin(x) - cos(x))",
+    "log(1 + x*x) + log(1 + x*x)^2 + log(1 + x*x)^3",
+};
+
+const int samples = 200000;
+
+double benchmarkInterpreter(Calculator& calculator, const std::string& expression, double& checksum) {
+    calculator.vm->reset();
+    calculator.compileInput(expression);
+
+    auto xSlot = calculator.vm->bind("x");
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < samples; ++i) {
+        double x = -1. + 2. * i / samples;
+        calculator.vm->setVar(xSlot, x);
+        checksum += calculator.executeInstructions();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / samples;
+}
+
+double benchmarkBatch(Calculator& calculator, const std::string& expression, double& checksum) {
+    calculator.vm->reset();
+    calculator.compileInput(expression);
+
+    auto xSlot = calculator.vm->bind("x");
+    std::vector<double> inputs(samples);
+    std::vector<double> outputs(samples);
+    for(int i = 0; i < samples; ++i) {
+        inputs[i] = -1. + 2. * i / samples;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    calculator.executeBatch(xSlot, inputs.data(), outputs.data(), samples);
+    auto end = std::chrono::steady_clock::now();
+
+    for(auto &i : outputs) {
+        checksum += i;
+    }
+    return std::chrono::duration<double, std::nano>(end - start).count() / samples;
+}
+
+void benchmarkCorpus(const std::string& name, const std::vector<std::string>& expressions) {
+    Calculator verbatim(false);
+    verbatim.setOptimize(false);
+    Calculator optimized(false);
+    Calculator jit(false);
+    jit.setJit(true);
+    double checksum = 0;
+    double optimizedChecksum = 0;
+    double batchChecksum = 0;
+    double jitChecksum = 0;
+
+    std::cout << std::left << std::setw(90) << name << std::setw(12) << "verbatim" << std::setw(12) << "optimized" << std::setw(12) << "batch" << std::setw(12) << "jit" << "ns/eval" << std::endl;
+    for(auto &expression : expressions) {
+        double verbatimNs = benchmarkInterpreter(verbatim, expression, checksum);
+        double optimizedNs = benchmarkInterpreter(optimized, expression, optimizedChecksum);
+        double batchNs = benchmarkBatch(optimized, expression, batchChecksum);
+        double jitNs = benchmarkInterpreter(jit, expression, jitChecksum);
+        std::cout << std::left << std::setw(90) << expression << std::fixed << std::setprecision(1)
+            << std::setw(12) << verbatimNs << std::setw(12) << optimizedNs << std::setw(12) << batchNs << std::setw(12) << jitNs << std::endl;
+    }
+    std::cout << "checksum " << checksum << " / " << optimizedChecksum << " / " << batchChecksum << " / " << jitChecksum << std::endl << std::endl;
+}
+
+// Recompiles every prefix of each expression, as the input field does while typing
+void benchmarkKeystrokes(const std::vector<std::string>& expressions) {
+    Calculator calculator(false);
+    int keystrokes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int repeat = 0; repeat < 20; ++repeat) {
+        for(auto &expression : expressions) {
+            for(size_t length = 1; length <= expression.size(); ++length) {
+                calculator.compileInput(std::string_view(expression).substr(0, length));
+                keystrokes++;
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << "compile per keystroke " << std::fixed << std::setprecision(1)
+        << std::chrono::duration<double, std::micro>(end - start).count() / keystrokes << " us" << std::endl << std::endl;
+}
+
+void benchmarkLexer(const std::vector<std::string>& expressions) {
+    // Long pasted input, mostly made of the identifier and number runs the scanner skips
+    std::string input;
+    while(input.size() < 512 * 1024) {
+        for(auto &expression : expressions) {
+            input += expression;
+            input += "; longVariableName123 = 3.14159265358979 * anotherLongName456;";
+        }
+    }
+
+    Parser parser(nullptr);
+    TokenList tokens;
+    const int repeats = 50;
+    size_t tokenCount = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for(int repeat = 0; repeat < repeats; ++repeat) {
+        parser.parseInput(input, tokens);
+        tokenCount += tokens.list.size();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "lex " << std::fixed << std::setprecision(1)
+        << input.size() * repeats / seconds / (1024 * 1024) << " MB/s (" << tokenCount / repeats << " tokens)" << std::endl;
+}
+
+void benchmarkDispatch(const std::vector<std::string>& expressions) {
+    // Interpreter dispatch alone, the optimized program run by the switch and threaded loops
+    std::cout << std::left << std::setw(90) << "dispatch" << std::setw(12) << "switch" << std::setw(12) << "threaded" << "M instructions/s" << std::endl;
+    Calculator calculator(false);
+    double checksum = 0;
+    double threadedChecksum = 0;
+    size_t instructionBytes = 0;
+    size_t programBytes = 0;
+
+    for(auto &expression : expressions) {
+        calculator.vm->reset();
+        calculator.compileInput(expression);
+        auto xSlot = calculator.vm->bind("x");
+        double instructions = (double)samples * calculator.compiledInstructions.size();
+        instructionBytes += calculator.compiledInstructions.size() * sizeof(Instruction);
+        programBytes += calculator.getProgram()->getByteSize();
+
+        auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < samples; ++i) {
+            calculator.vm->setVar(xSlot, -1. + 2. * i / samples);
+            calculator.vm->execute(calculator.compiledInstructions);
+            checksum += calculator.vm->getRegister(calculator.resultRegister);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for(int i = 0; i < samples; ++i) {
+            calculator.vm->setVar(xSlot, -1. + 2. * i / samples);
+            calculator.vm->execute(*calculator.getProgram());
+            threadedChecksum += calculator.vm->getRegister(calculator.resultRegister);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        std::cout << std::setw(90) << expression << std::fixed << std::setprecision(1)
+            << std::setw(12) << instructions / std::chrono::duration<double, std::micro>(middle - start).count()
+            << std::setw(12) << instructions / std::chrono::duration<double, std::micro>(end - middle).count() << std::endl;
+    }
+    std::cout << "checksum " << checksum << " / " << threadedChecksum << std::endl;
+    std::cout << "bytes per program " << instructionBytes / expressions.size() << " as instructions, "
+        << programBytes / expressions.size() << " as Program" << std::endl << std::endl;
+}
+
+void benchmarkSampler(const std::vector<std::string>& expressions) {
+    // Graph sampling on one thread against the pool, same program and inputs
+    auto pool = std::make_shared<ThreadPool>();
+    GraphSampler sampler(pool);
+    std::cout << std::left << std::setw(90) << "sampling" << std::setw(12) << "serial" << std::setw(12) << "pool"
+        << "ms per " << samples << " samples, " << pool->getParticipantCount() << " threads" << std::endl;
+
+    std::vector<double> xs(samples);
+    for(int i = 0; i < samples; ++i) {
+        xs[i] = -1. + 2. * i / samples;
+    }
+    std::vector<double> serial(samples);
+    std::vector<double> parallel(samples);
+    bool identical = true;
+
+    for(auto &expression : expressions) {
+        Calculator calculator(false);
+        calculator.compileInput(expression);
+        auto program = calculator.getProgram();
+        int slot = program->findSlot("x");
+
+        auto start = std::chrono::steady_clock::now();
+        ExecutionContext context;
+        context.prepare(*program);
+        for(int i = 0; i < samples; ++i) {
+            context.setVar(slot, xs[i]);
+            serial[i] = context.execute(*program);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        sampler.sample(*program, slot, xs.data(), parallel.data(), samples);
+        auto end = std::chrono::steady_clock::now();
+
+        identical = identical && serial == parallel;
+        std::cout << std::setw(90) << expression << std::fixed << std::setprecision(2)
+            << std::setw(12) << std::chrono::duration<double, std::milli>(middle - start).count()
+            << std::setw(12) << std::chrono::duration<double, std::milli>(end - middle).count() << std::endl;
+    }
+    std::cout << "results " << (identical ? "identical" : "DIFFER") << std::endl << std::endl;
+}
+
+// Largest distance between the program and the lines joining the samples on a dense grid,
+// both clipped to the view as the graph draws them
+static double interpolationError(const Program& program, int slot, const std::vector<double>& xs, const std::vector<double>& ys) {
+    ExecutionContext context;
+    context.prepare(program);
+    double error = 0.;
+    size_t segment = 0;
+    for(int i = 0; i <= samples; ++i) {
+        double x = xs.front() + (xs.back() - xs.front()) * i / samples;
+        while(segment + 2 < xs.size() && xs[segment + 1] < x) {
+            segment++;
+        }
+        double t = (x - xs[segment]) / (xs[segment + 1] - xs[segment]);
+        context.setVar(slot, x);
+        double y = context.execute(program);
+        double line = ys[segment] + (ys[segment + 1] - ys[segment]) * t;
+        if(std::isfinite(y) && std::isfinite(line)) {
+            error = std::max(error, std::fabs(std::clamp(y, -1., 1.) - std::clamp(line, -1., 1.)));
+        }
+    }
+    return error;
+}
+
+void benchmarkAdaptive(const std::vector<std::string>& expressions) {
+    // Half a pixel of an 800 pixel square view of -1..1, against the fixed 800 step grid
+    // it replaces, and with refinement limited by interval bounds
+    const size_t uniformCount = 801;
+    const double pixels = 800. / 2.;
+    GraphSampler sampler(std::make_shared<ThreadPool>());
+    GraphSampler::AdaptiveSettings settings;
+    settings.tolerance = 1. / 800.;
+    settings.bottom = -1.;
+    settings.top = 1.;
+    std::cout << std::left << std::setw(60) << "adaptive sampling" << std::setw(12) << "uniform px" << std::setw(10) << "samples"
+        << std::setw(10) << "px" << std::setw(10) << "ms" << std::setw(10) << "culled" << std::setw(10) << "px" << "ms" << std::endl;
+
+    std::vector<double> uniformXs(uniformCount);
+    std::vector<double> uniformYs(uniformCount);
+    for(size_t i = 0; i < uniformCount; ++i) {
+        uniformXs[i] = settings.start + (settings.end - settings.start) * i / (uniformCount - 1);
+    }
+    std::vector<double> xs;
+    std::vector<double> ys;
+
+    for(auto &expression : expressions) {
+        Calculator calculator(false);
+        calculator.compileInput(expression);
+        auto program = calculator.getProgram();
+        int slot = program->findSlot("x");
+        sampler.sample(*program, slot, uniformXs.data(), uniformYs.data(), uniformCount);
+        std::cout << std::setw(60) << expression << std::fixed << std::setprecision(3)
+            << std::setw(12) << interpolationError(*program, slot, uniformXs, uniformYs) * pixels;
+
+        for(bool cull : {false, true}) {
+            settings.cull = cull;
+            const int repeats = 20;
+            size_t evaluations = 0;
+            auto start = std::chrono::steady_clock::now();
+            for(int i = 0; i < repeats; ++i) {
+                evaluations = sampler.sampleAdaptive(*program, slot, settings, xs, ys);
+            }
+            auto end = std::chrono::steady_clock::now();
+            std::cout << std::setw(10) << evaluations << std::setw(10) << interpolationError(*program, slot, xs, ys) * pixels
+                << std::setw(10) << std::chrono::duration<double, std::milli>(end - start).count() / repeats;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void benchmarkWorker(const std::vector<std::string>& expressions) {
+    // Typing each expression as a graph, the time a keystroke holds the input thread when it
+    // compiles and samples itself against handing the text to the worker, and how long after
+    // the last keystroke the worker's curve for it arrives
+    GraphSampler::AdaptiveSettings settings;
+    settings.tolerance = 1. / 800.;
+    settings.initialIntervals = 200;
+    settings.bottom = -1.;
+    settings.top = 1.;
+    Calculator calculator(false);
+    calculator.setJit(true);
+    GraphSampler sampler(std::make_shared<ThreadPool>());
+    EvaluationWorker worker;
+    std::vector<double> xs;
+    std::vector<double> ys;
+    std::cout << std::left << std::setw(60) << "keystroke latency" << std::setw(14) << "inline max ms" << std::setw(14) << "submit us"
+        << std::setw(14) << "submit max us" << "curve after ms" << std::endl;
+
+    for(auto &expression : expressions) {
+        double inlineMax = 0;
+        for(size_t length = 1; length <= expression.size(); ++length) {
+            auto start = std::chrono::steady_clock::now();
+            calculator.compileInput(std::string_view(expression).substr(0, length));
+            auto program = calculator.getProgram();
+            if(calculator.resultIsValid() && calculator.isGraph) {
+                sampler.sampleAdaptive(*program, program->findSlot("x"), settings, xs, ys);
+            }
+            auto end = std::chrono::steady_clock::now();
+            inlineMax = std::max(inlineMax, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        double submitTotal = 0;
+        double submitMax = 0;
+        uint64_t version = 0;
+        auto lastKeystroke = std::chrono::steady_clock::now();
+        for(size_t length = 1; length <= expression.size(); ++length) {
+            auto start = std::chrono::steady_clock::now();
+            version = worker.submit(std::string_view(expression).substr(0, length), settings);
+            auto end = std::chrono::steady_clock::now();
+            double submitUs = std::chrono::duration<double, std::micro>(end - start).count();
+            submitTotal += submitUs;
+            submitMax = std::max(submitMax, submitUs);
+            lastKeystroke = end;
+        }
+        while(!worker.poll() || worker.current().version != version || (worker.current().isGraph && !worker.current().hasCurve)) {
+            std::this_thread::yield();
+        }
+        auto arrived = std::chrono::steady_clock::now();
+        std::cout << std::setw(60) << expression << std::fixed << std::setprecision(3) << std::setw(14) << inlineMax
+            << std::setw(14) << submitTotal / expression.size() << std::setw(14) << submitMax << std::chrono::duration<double, std::milli>(arrived - lastKeystroke).count() << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+int main() {
+    benchmarkLexer(corpus);
+    benchmarkKeystrokes(corpus);
+    benchmarkCorpus("expression", corpus);
+    benchmarkCorpus("redundant expression", redundantCorpus);
+    benchmarkDispatch(corpus);
+    benchmarkDispatch(redundantCorpus);
+    benchmarkSampler(corpus);
+    benchmarkAdaptive(corpus);
+    benchmarkAdaptive(steepCorpus);
+    benchmarkWorker(corpus);
+    benchmarkWorker(steepCorpus);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <math.h>
+#include <cmath>
+#include <algorithm>
+
+// Bodies of the builtin functions. Functions' table points at these, and the threaded
+// interpreter calls them directly so each builtin can be its own inlined opcode.
+class Builtins {
+    public:
+    static double max(double a, double b) { return std::max(a, b); }
+    static double min(double a, double b) { return std::min(a, b); }
+    static double saturate(double a) { return std::max(0., std::min(1., a)); }
+    static double clamp(double a, double b, double c) { return std::max(b, std::min(c, a)); }
+    static double sin(double a) { return ::sin(a); }
+    static double cos(double a) { return ::cos(a); }
+    static double tan(double a) { return ::tan(a); }
+    static double asin(double a) { return ::asin(a); }
+    static double acos(double a) { return ::acos(a); }
+    static double atan(double a) { return ::atan(a); }
+    static double atan2(double a, double b) { return ::atan2(a, b); }
+    static double cosh(double a) { return ::cosh(a); }
+    static double tanh(double a) { return ::tanh(a); }
+    static double asinh(double a) { return ::asinh(a); }
+    static double acosh(double a) { return ::acosh(a); }
+    static double atanh(double a) { return ::atanh(a); }
+    static double sqrt(double a) { return ::sqrt(a); }
+    static double cbrt(double a) { return ::cbrt(a); }
+    static double rsqrt(double a) { return 1. / ::sqrt(a); }
+    static double abs(double a) { return std::fabs(a); }
+    static double sign(double a) { return std::copysign(1., a); }
+    static double pow(double a, double b) { return ::pow(a, b); }
+    static double exp(double a) { return ::exp(a); }
+    static double exp2(double a) { return ::exp2(a); }
+    static double exp10(double a) {
+#if defined(__GLIBC__)
+        return ::exp10(a);
+#elif defined(__APPLE__)
+        return __exp10(a);
+#else
+        return ::pow(10, a);
+#endif
+    }
+    static double log(double a) { return ::log(a); }
+    static double log2(double a) { return ::log2(a); }
+    static double log10(double a) { return ::log10(a); }
+    static double ceil(double a) { return ::ceil(a); }
+    static double floor(double a) { return ::floor(a); }
+    static double round(double a) { return ::round(a); }
+    static double fract(double a) { return a - ::floor(a); }
+};
@@ -1,12 +1,17 @@
 #include "CalcError.h"
 
-CalcError::CalcError(Token token, std::string message) :token(token), message(message) {
+CalcError::CalcError(const Token& token, std::string_view value, const char* message) :token(token), value(value), message(message) {
+    this->token.setOffset(0);
 }
 
-Token CalcError::getToken() {
+Token CalcError::getToken() const {
     return token;
 }
 
-std::string CalcError::getMessage() {
+std::string_view CalcError::getValue() const {
+    return value;
+}
+
+std::string_view CalcError::getMessage() const {
     return message;
-}
\ No newline at end of file
+}
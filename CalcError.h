@@ -1,16 +1,21 @@
 #pragma once
-#include <memory>
-#include <string>
+#include <string_view>
 
 #include "Token.h"
 
+// A diagnostic. Errors are stored by value in the Calculator and their text lives in its
+// arena, so they are valid until the next compilation and hold views rather than strings.
 class CalcError {
     public:
-    CalcError(Token token, std::string message);
-    Token getToken();
-    std::string getMessage();
+    // value must outlive the error, message is a string literal
+    CalcError(const Token& token, std::string_view value, const char* message);
+    // The token, relative to getValue()
+    Token getToken() const;
+    std::string_view getValue() const;
+    std::string_view getMessage() const;
 
     private:
     Token token;
-    std::string message;
-};
\ No newline at end of file
+    std::string_view value;
+    const char* message;
+};
@@ -5,10 +5,10 @@
 #include <stack>
 #include <map>
 #include <math.h>
+#include <algorithm>
 
 #include "TokenList.h"
 #include "Parser.h"
-#include "Lexer.h"
 #include "Token.h"
 #include "Functions.h"
 #include "CalcError.h"
@@ -16,446 +16,289 @@
 #include "FunctionType.h"
 #include "Instruction.h"
 #include "InstructionVM.h"
+#include "BatchVM.h"
+#include "Optimizer.h"
+#include "Verifier.h"
+#include "JitProgram.h"
+#include "Program.h"
+#include "Ast.h"
+#include "AstParser.h"
+#include "Arena.h"
+
+// Front end output for one line, reused while the line's text is unchanged
+struct Calculator::LineStages {
+    TokenList parsed;
+    Ast ast;
+    int root = -1;
+    bool valid = false;
+};
 
 Calculator::Calculator(bool debug)
-    :debug(debug), lexer(std::make_shared<Lexer>(this)), parser(std::make_shared<Parser>(this)), vm(std::make_shared<InstructionVM>()) {
+    :parser(std::make_shared<Parser>(this)), astParser(std::make_shared<AstParser>(this)), vm(std::make_shared<InstructionVM>()), batchVm(std::make_shared<BatchVM>()), arena(std::make_shared<Arena>()), program(std::make_shared<Program>()), debug(debug) {
     parsed = new TokenList();
     validResult = true;
     isGraph = false;
+    registerCount = 0;
+    resultRegister = -1;
+    optimize = true;
+    jit = false;
+    removedInstructionCount = 0;
+    compiledInputIsCurrent = false;
+    lineCache = std::make_shared<std::vector<LineStages>>();
+    spareLineCache = std::make_shared<std::vector<LineStages>>();
     clearErrors();
 }
 
-int Calculator::getPrecedence(std::string_view in) {
-    char i = ' ';
-    if(in.length() >= 1) {
-        i = in[0];
-        for(auto &o : Parser::operators) {
-            if(i == o.first)
-                return o.second;
+int Calculator::compileAst(const TokenList& tokens, const Ast& ast, int root, std::vector<Instruction>& instructions) {
+    // Post order walk with an explicit stack, trees from generated input can be very deep
+    ArenaVector<int> nodeRegisters(ast.size(), -1, *arena);
+    ArenaVector<std::pair<int, bool>> stack(*arena);
+    stack.push_back({root, false});
+
+    while(!stack.empty()) {
+        auto [index, visited] = stack.back();
+        const AstNode& node = ast.get(index);
+
+        if(!visited) {
+            stack.back().second = true;
+            // The target of an assignment is written, not read
+            int firstChild = node.kind == AstNode::NODE_ASSIGN ? 1 : 0;
+            for(int c = node.childCount - 1; c >= firstChild; --c) {
+                stack.push_back({node.children[c], false});
+            }
+            continue;
         }
-    }
-    return 0;
-}
-
-TokenList Calculator::performShuntingYard(const TokenList& tokens) {
-    std::stack<Token> operatorStack;
-    TokenList outputQueue;
-
-    for (const auto& token : tokens.list) {
-        int tokenType = token.getType();
-        std::string tokenValue = token.getValue();
-
-        if(tokenType == Token::TOKEN_COMMA) {
-            reportError(new CalcError(token, "Unexpected comma"));
-        } else if(tokenType == Token::TOKEN_IDENTIFIER) {
-            Token refTkn = Token(tokenType, tokenValue);
-            if(refTkn.isResolved()) {
-                reportError(new CalcError(refTkn, "Missing function body"));
-            } else {
-                reportError(new CalcError(refTkn, "Unknown Identifier"));
+        stack.pop_back();
+
+        int dst = -1;
+        int a = node.childCount > 0 ? nodeRegisters[node.children[0]] : 0;
+        int b = node.childCount > 1 ? nodeRegisters[node.children[1]] : 0;
+        int c = node.childCount > 2 ? nodeRegisters[node.children[2]] : 0;
+
+        switch(node.kind) {
+            case AstNode::NODE_NUMBER:
+                dst = registerCount++;
+                instructions.push_back(Instruction(Instruction::OP_LOAD_CONSTANT, dst, 0, 0, 0, Operand(Operand::TYPE_NUMBER, node.value)));
+                break;
+            case AstNode::NODE_VARIABLE: {
+                const std::string& name = ast.getName(node.id);
+                if(name == "x")
+                    isGraph = true;
+                dst = registerCount++;
+                instructions.push_back(Instruction(Instruction::OP_LOAD_VARIABLE, dst, vm->bind(name), 0, 0, Operand(Operand::TYPE_VARIABLE, name)));
+                break;
             }
-        } else if (tokenType == Token::TOKEN_NUMBER || tokenType == Token::TOKEN_FUNCTION || tokenType == Token::TOKEN_VARIABLE) {
-            outputQueue.list.push_back(token);
-        } else if (tokenType == Token::TOKEN_OPERATOR) {
-            while (!operatorStack.empty() && operatorStack.top().isType(Token::TOKEN_OPERATOR) &&
-                   getPrecedence(operatorStack.top().getValue()) >= getPrecedence(tokenValue)) {
-                outputQueue.list.push_back(operatorStack.top());
-                operatorStack.pop();
+            case AstNode::NODE_NEGATE: {
+                int k = registerCount++;
+                instructions.push_back(Instruction(Instruction::OP_LOAD_CONSTANT, k, 0, 0, 0, Operand(Operand::TYPE_NUMBER, -1.)));
+                dst = registerCount++;
+                instructions.push_back(Instruction(Instruction::OP_MUL, dst, a, k));
+                break;
             }
-            operatorStack.push(token);
-        } else if (tokenType == Token::TOKEN_OPEN_PARENTHESIS) {
-            operatorStack.push(token);
-        } else if (tokenType == Token::TOKEN_CLOSE_PARENTHESIS) {
-            while (!operatorStack.empty() && !operatorStack.top().isType(Token::TOKEN_OPEN_PARENTHESIS)) {
-                outputQueue.list.push_back(operatorStack.top());
-                operatorStack.pop();
+            case AstNode::NODE_BINARY: {
+                const AstNode& divisor = ast.get(node.children[1]);
+                if(node.id == Instruction::OP_DIV && divisor.kind == AstNode::NODE_NUMBER && divisor.value == 0.) {
+                    reportError(tokens.list[node.token], tokens.source, "Division by zero");
+                    return -1;
+                }
+                dst = registerCount++;
+                instructions.push_back(Instruction(node.id, dst, a, b));
+                break;
             }
-
-            if (operatorStack.empty() || !operatorStack.top().isType(Token::TOKEN_OPEN_PARENTHESIS)) {
-                if(!operatorStack.empty())
-                    reportError(new CalcError(operatorStack.top(), "Mismatched Parentheses"));
-                else
-                    reportError(new CalcError(Token(Token::TOKEN_CLOSE_PARENTHESIS, ")"), "Mismatched Parentheses"));
-
-                throw std::runtime_error("Mismatched parentheses");
+            case AstNode::NODE_CALL:
+                dst = registerCount++;
+                instructions.push_back(Instruction(Instruction::OP_CALL1 + node.childCount - 1, dst, a, b, c, Operand(Operand::TYPE_FUNCTION, node.id)));
+                break;
+            case AstNode::NODE_ASSIGN: {
+                const std::string& name = ast.getName(ast.get(node.children[0]).id);
+                instructions.push_back(Instruction(Instruction::OP_STORE_VARIABLE, -1, b, vm->bind(name), 0, Operand(Operand::TYPE_VARIABLE, name)));
+                // The value of an assignment is the assigned value
+                dst = b;
+                break;
             }
-
-            operatorStack.pop();
-        }
-    }
-
-    while (!operatorStack.empty()) {
-        if (operatorStack.top().isType(Token::TOKEN_OPEN_PARENTHESIS) ||
-            operatorStack.top().isType(Token::TOKEN_CLOSE_PARENTHESIS)) {
-            reportError(new CalcError(operatorStack.top(), "Mismatched Parentheses"));
-            throw std::runtime_error("Mismatched parentheses");
         }
-
-        outputQueue.list.push_back(operatorStack.top());
-        operatorStack.pop();
+        nodeRegisters[index] = dst;
     }
 
-    return outputQueue;
+    return nodeRegisters[root];
 }
 
-double Calculator::computeFunctionResult(const Token func) {
-    TokenList tokens;
-    parser->parseInput(func.getValue(), tokens);
-
-    // std::cout << "---computeFunctionResult---" << std::endl;
-    // printTokenList(tokens);
-
-    if(tokens.list.size() < 3) {
-        throw std::runtime_error("computeFunctionResult -> invalid function call, too few tokens");
+bool Calculator::parseLine(std::string_view line, LineStages& stages) {
+    for(auto &i : *lineCache) {
+        if(i.valid && i.parsed.source == line) {
+            stages = i;
+            return true;
+        }
     }
 
-    Token identifier = tokens.list[0];
+    size_t errorCount = errors.size();
+    parser->parseInput(line, stages.parsed);
+    stages.ast.clear();
 
-    if(!identifier.isType(Token::TOKEN_IDENTIFIER)) {
-        throw std::runtime_error("computeFunctionResult -> First token is not an identifier");
+    if(debug) {
+        std::cout << "---Input---" << std::endl;
+        stages.parsed.print();
     }
 
-    std::vector<TokenList> parameters;
-    parameters.push_back(TokenList());
-
-    int parenthesisCount = 0;
-    for(int i = 1; i < tokens.list.size(); ++i) {
-        int tokenType = tokens.list[i].getType();
-        if(tokenType == Token::TOKEN_OPEN_PARENTHESIS) {parenthesisCount++;}
-        else if(tokenType == Token::TOKEN_CLOSE_PARENTHESIS) {parenthesisCount--;}
-
-        if(tokenType == Token::TOKEN_OPEN_PARENTHESIS && parenthesisCount == 1) continue;
-        if(tokenType == Token::TOKEN_CLOSE_PARENTHESIS && parenthesisCount == 0) continue;
-        if(parenthesisCount == 1 && tokenType == Token::TOKEN_COMMA) {
-            parameters.push_back(TokenList());
-            continue;
-        }
+    stages.root = astParser->parse(stages.parsed, stages.ast);
+    stages.valid = errors.size() == errorCount;
+    return stages.valid;
+}
 
-        parameters.back().list.push_back(tokens.list[i]);
+void Calculator::compileInput(std::string_view input) {
+    if(compiledInputIsCurrent && compiledInput == input) {
+        return;
     }
+    compiledInput.assign(input.data(), input.size());
+    compiledInputIsCurrent = true;
 
-    // for(auto &i : parameters) {
-    //     std::cout << "---computeFunctionResult--- parameter" << std::endl;
-    //     printTokenList(i);
-    // }
-
-    if(Functions::exists(identifier.getValue())) {
-        auto func = Functions::get(identifier.getValue());
-        if(parameters.size() == func.second) {
-            ParameterList_t params;
-            for(auto &i : parameters) {
-                if(i.list.size() == 0) {
-                    reportError(new CalcError(identifier, "Empty parameter"));
-                    throw std::runtime_error("Empty parameter");
-                }
-                params.push_back(processTokens(i));
-            }
-            return func.first(params);
-        } else {
-            reportError(new CalcError(identifier, "Too " + (parameters.size() >= func.second ? std::string("Many") : std::string("Few")) + " parameters."));
-            throw std::runtime_error("Too " + (parameters.size() >= func.second ? std::string("Many") : std::string("Few")) + " parameters.");
-        }
+    // Everything from the previous compilation, errors included, goes at once
+    clearErrors();
+    arena->reset();
+    // Names are bound as they are compiled, the table holds this input's and no others
+    vm->clearVariables();
+    validResult = true;
+    isGraph = false;
+    parsed->source.assign(input.data(), input.size());
+    parsed->list.clear();
+    compiledInstructions.clear();
+    registerCount = 0;
+    resultRegister = -1;
+    removedInstructionCount = 0;
+    // Programs that have been handed out stay as they are, compile into a new one
+    if(program.use_count() > 1) {
+        program = std::make_shared<Program>();
     } else {
-        reportError(new CalcError(identifier, "Unknown function"));
-        throw std::runtime_error("Unknown function " + identifier.getValue());
+        program->clear();
     }
+    jitProgram.reset();
 
-    return 0.0;
-}
-
-void Calculator::compileFunctionCall(const Token func, std::vector<Instruction>& instructions, std::string &funcName) {
-    TokenList tokens;
-    parser->parseInput(func.getValue(), tokens);
-
-    Token identifier = tokens.list[0];
-
-    std::vector<TokenList> parameters;
-    parameters.push_back(TokenList());
-
-    int parenthesisCount = 0;
-    for(int i = 1; i < tokens.list.size(); ++i) {
-        int tokenType = tokens.list[i].getType();
-        if(tokenType == Token::TOKEN_OPEN_PARENTHESIS) {parenthesisCount++;}
-        else if(tokenType == Token::TOKEN_CLOSE_PARENTHESIS) {parenthesisCount--;}
-
-        if(tokenType == Token::TOKEN_OPEN_PARENTHESIS && parenthesisCount == 1) continue;
-        if(tokenType == Token::TOKEN_CLOSE_PARENTHESIS && parenthesisCount == 0) continue;
-        if(parenthesisCount == 1 && tokenType == Token::TOKEN_COMMA) {
-            parameters.push_back(TokenList());
-            continue;
-        }
+    ArenaVector<std::string_view> lines(*arena);
+    parser->preprocessInput(input, lines);
+    uint32_t lineOffset = 0;
 
-        parameters.back().list.push_back(tokens.list[i]);
+    // Stages are parsed into the spare cache, whose buffers are reused from two compilations ago
+    if(spareLineCache->size() < lines.size()) {
+        spareLineCache->resize(lines.size());
     }
-
-    if(Functions::exists(identifier.getValue())) {
-        funcName = identifier.getValue();
-        auto func = Functions::get(identifier.getValue());
-        if(parameters.size() == func.second) {
-            for(auto &i : parameters) {
-                lexer->lexInput(i);
-                TokenList shunted = performShuntingYard(i);
-                std::vector<Instruction> localByteCode;
-                compileTokens(shunted, localByteCode);
-                for(auto &i : localByteCode) {
-                    instructions.push_back(i);
-                }
-            }
-            return;
+    for(int line = 0; line < lines.size(); ++line) {
+        auto &i = lines[line];
+        LineStages& stages = (*spareLineCache)[line];
+        bool valid = parseLine(i, stages);
+        // The line's tokens are relative to the line, rebase them onto the whole input
+        for(auto token : stages.parsed.list) {
+            token.setOffset(token.getOffset() + lineOffset);
+            parsed->list.push_back(token);
         }
-    }
-}
-
-void Calculator::compileTokens(const TokenList& tokens, std::vector<Instruction>& instructions) {
-        for (const auto& token : tokens.list) {
-            if(token.isType(Token::TOKEN_NUMBER)) {
-                try {
-                    instructions.push_back(
-                        Instruction(Instruction::OP_PUSH, Operand(Operand::TYPE_NUMBER, std::stod(token.getValue())))
-                    );
-                } catch (std::exception &e){
-                    reportError(new CalcError(Token(Token::TOKEN_NUMBER, ""), "Compilation error: " + std::string(e.what()) + " " + token.getValue()));
-                }
-            } else if(token.isType(Token::TOKEN_VARIABLE)) {
-                if(token.getValue() == "x")
-                    isGraph = true;
-
-                instructions.push_back(
-                    Instruction(Instruction::OP_PUSH, Operand(Operand::TYPE_VARIABLE, token.getValue()))
-                );
-            } else if(token.isType(Token::TOKEN_OPERATOR)) {
-                instructions.push_back(
-                    Instruction(Instruction::OP_OPERATOR, Operand(Operand::TYPE_OPERATOR, (char)token.getValue()[0]))
-                );
-            } else if(token.isType(Token::TOKEN_FUNCTION)) {
-                std::vector<Instruction> funcByteCode;
-                std::string funcName;
-                compileFunctionCall(token, funcByteCode, funcName);
-                for(auto &i : funcByteCode) {
-                    instructions.push_back(i);
-                }
-                instructions.push_back(
-                    Instruction(Instruction::OP_CALL, Operand(Operand::TYPE_FUNCTION, funcName))
-                );
-            }
+        lineOffset += i.size();
+        if(!valid || stages.root < 0) {
+            continue;
         }
-}
-
-double Calculator::computeResult(const TokenList& outputQueue) { //TODO: deprecate this, only used for error checking
-    if(outputQueue.list.size() == 0) {
-        return 0;
-    }
-
-    std::stack<double> operandStack;
-    std::stack<int> typeStack;
-
-    for (const auto& token : outputQueue.list) {
-        const int tokenType = token.getType();
-        std::string tokenValue = token.getValue();
-
-        if (tokenType == Token::TOKEN_IDENTIFIER) {
-            reportError(new CalcError(Token(tokenType, tokenValue), "Unknown Identifier"));
-        } else if (tokenType == Token::TOKEN_VARIABLE) {
-                operandStack.push(0.);
-                typeStack.push(Operand::TYPE_VARIABLE);
-        } else if (tokenType == Token::TOKEN_NUMBER) {
-            try {
-                operandStack.push(std::stod(tokenValue));
-                typeStack.push(Operand::TYPE_NUMBER);
-            } catch(std::exception &e) {
-                reportError(new CalcError(Token(tokenType, tokenValue), "Invalid Number"));
-                return 0;
-            }
-        } else if (tokenType == Token::TOKEN_FUNCTION) {
-            operandStack.push(computeFunctionResult(token));
-            typeStack.push(Operand::TYPE_FUNCTION);
-        } else if (tokenType == Token::TOKEN_OPERATOR) {
-            if(!Token(tokenType, tokenValue).isValidOperator()) {
-                reportError(new CalcError(Token(tokenType, tokenValue), "Invalid Operator: " + tokenValue));
-                throw std::runtime_error("Invalid expression");
-            }
 
-            if (operandStack.size() < 2) {
-                reportError(new CalcError(Token(tokenType, tokenValue), "Invalid Expression: " + tokenValue + " requires 2 operands."));
-                throw std::runtime_error("Invalid expression");
-            }
-
-            double operand2 = operandStack.top();
-            int operand2Type = typeStack.top();
-            operandStack.pop();
-            typeStack.pop();
-
-            double operand1 = operandStack.top();
-            int operand1Type = typeStack.top();
-            operandStack.pop();
-            typeStack.pop();
-
-            if (tokenValue == "+") {
-                operandStack.push(operand1 + operand2);
-                typeStack.push(Operand::TYPE_NUMBER);
-            } else if (tokenValue == "-") {
-                operandStack.push(operand1 - operand2);
-                typeStack.push(Operand::TYPE_NUMBER);
-            } else if (tokenValue == "*") {
-                operandStack.push(operand1 * operand2);
-                typeStack.push(Operand::TYPE_NUMBER);
-            } else if (tokenValue == "^") {
-                operandStack.push(pow(operand1, operand2));
-                typeStack.push(Operand::TYPE_NUMBER);
-            } else if (tokenValue == "%") {
-                operandStack.push((int)operand1 % (int)operand2);
-                typeStack.push(Operand::TYPE_NUMBER);
-            } else if (tokenValue == "/") {
-                if (operand2 == 0) {
-                    reportError(new CalcError(Token(tokenType, tokenValue), "Division by zero"));
-                    throw std::runtime_error("Division by zero");
-                }
-                operandStack.push(operand1 / operand2);
-                typeStack.push(Operand::TYPE_NUMBER);
-            } else if (tokenValue == "=") {
-                if(operand1Type != Operand::TYPE_VARIABLE) {
-                    reportError(new CalcError(Token(tokenType, tokenValue), "Invalid Assignment, left hand side must be a variable"));
-                    throw std::runtime_error("Invalid assignment");
-                }
-                operandStack.push(operand1 = operand2);
-                typeStack.push(Operand::TYPE_NUMBER);
-            } else {
-                reportError(new CalcError(Token(tokenType, tokenValue), "Invalid Operator"));
-                throw std::runtime_error("Invalid operator");
-            }
+        int lineResult = compileAst(stages.parsed, stages.ast, stages.root, compiledInstructions);
+        if(lineResult >= 0) {
+            resultRegister = lineResult;
         }
     }
-
-    if (operandStack.size() != 1) {
-        reportError(new CalcError(Token(Token::TOKEN_EXPRESSION, parsed->toString()), "Incomplete expression"));
-        throw std::runtime_error("Invalid expression");
+    // Lines past the end of this input are stale
+    for(int line = lines.size(); line < spareLineCache->size(); ++line) {
+        (*spareLineCache)[line].valid = false;
     }
+    std::swap(lineCache, spareLineCache);
 
-    return operandStack.top();
-}
-
-double Calculator::processTokens(TokenList& list) {
-    lexer->lexInput(list);
+    hintTokens(*parsed);
 
-    if(debug) {
-        std::cout << "---Lexed Input---" << std::endl;
-        list.print();
+    if(!validResult) {
+        compiledInstructions.clear();
+        resultRegister = -1;
+        return;
     }
-
-    TokenList shuntedList;
-    try {
-        shuntedList = performShuntingYard(list);
-    } catch (std::runtime_error &e) {
-        if(debug)
-            std::cout << "performShuntingYard() Error: " << e.what() << std::endl;
-
-        validResult = false;
+    // Reported once here rather than on every execution of the same failed compile
+    if(resultRegister < 0) {
+        reportError(Token(Token::TOKEN_EXPRESSION, 0, input.size()), input, "No result");
+        compiledInstructions.clear();
+        return;
     }
 
-    if(debug) {
-        std::cout << "---Shunted---" << std::endl;
-        shuntedList.print();
+    if(optimize) {
+        removedInstructionCount = Optimizer::optimize(compiledInstructions, registerCount, resultRegister, *arena);
+        if(debug) {
+            std::cout << "Optimizer removed " << removedInstructionCount << " instructions" << std::endl;
+        }
     }
 
-    double result = 0.0;
-    try {
-        result = computeResult(shuntedList);
-    } catch (std::runtime_error &e) {
-        if(debug)
-            std::cout << "computeResult() Error: " << e.what() << std::endl;
-
-        validResult = false;
-        //error = e.what();
+    if(resultRegister >= 0) {
+        Optimizer::compactRegisters(compiledInstructions, registerCount, resultRegister, *arena);
+        // Anything rejected by the verifier is a compiler bug, but it must never reach the VM.
+        // Encoding only fails for expressions too large for the program's 16 bit fields.
+        const char* problem = Verifier::verify(compiledInstructions, registerCount, resultRegister, vm->getVariableNames().size(), *arena);
+        if(!problem) {
+            problem = program->assign(compiledInstructions, registerCount, resultRegister, vm->getVariableNames(), *arena);
+        }
+        if(problem) {
+            reportError(Token(Token::TOKEN_EXPRESSION, 0, input.size()), input, problem);
+            compiledInstructions.clear();
+            resultRegister = -1;
+            return;
+        }
+        vm->reserveRegisters(registerCount);
     }
 
-    return result;
+    if(jit) {
+        jitProgram = JitProgram::compile(compiledInstructions, registerCount, resultRegister);
+        if(debug && jitProgram) {
+            std::cout << "JIT emitted " << jitProgram->getCodeSize() << " bytes" << std::endl;
+        }
+    }
 }
 
-double Calculator::calculateInput(std::string_view input) {
-    clearErrors();
-    validResult = true;
-    isGraph = false;
-
-    std::vector<std::string> lines;
-    parser->preprocessInput(input, lines);
-    
-    parsed->list.clear();
-
-    for(auto&i : lines) {
-        TokenList parsedInput;
-        parser->parseInput(i, parsedInput);
-        for(auto&i : parsedInput.list) {
-            parsed->list.push_back(i);
-        }
+void Calculator::setDebug(bool nDebug) {
+    debug = nDebug;
+    compiledInputIsCurrent = false;
+}
 
-        if(debug) {
-            std::cout << "---Input---" << std::endl;
-            parsedInput.print();
-        }
+void Calculator::setOptimize(bool nOptimize) {
+    optimize = nOptimize;
+    compiledInputIsCurrent = false;
+}
 
-        processTokens(parsedInput);
-    }
-    
-    hintTokens(*parsed);
+int Calculator::getRemovedInstructionCount() const {
+    return removedInstructionCount;
+}
 
-    return 0;
+void Calculator::setJit(bool nJit) {
+    jit = nJit;
+    compiledInputIsCurrent = false;
 }
 
-void Calculator::compileInput(std::string_view input) {
-    calculateInput(input); //TODO: lame way to error check
-    compiledInstructions.clear();
-    if(validResult) {
-        std::vector<std::string> lines;
-        parser->preprocessInput(input, lines);
-
-        for(auto&i : lines) {
-            TokenList list;
-            parser->parseInput(i, list);
-            lexer->lexInput(list);
-            TokenList shuntedList;
-            shuntedList = performShuntingYard(list);
-            compileTokens(shuntedList, compiledInstructions);
-        }
-    }
+std::shared_ptr<const Program> Calculator::getProgram() const {
+    return program;
 }
 
-void Calculator::setDebug(bool nDebug) {
-    debug = nDebug;
+bool Calculator::isJitCompiled() const {
+    return jitProgram != nullptr;
 }
 
 void Calculator::hintTokens(TokenList& list) {
-    int parenthesisDepth = 0;
-    int pairId = 0;
-    int deepestParenthesis = 0;
+    // Tokens inside a pair of parentheses share the pair's id, which is unique across the
+    // input so each pair can be highlighted on its own
+    ArenaVector<int> openPairs(*arena);
+    int uniqueId = 0;
 
     for(auto &i : list.list) {
-        int depthToSet = parenthesisDepth;
         if(i.isType(Token::TOKEN_OPEN_PARENTHESIS)) {
-            parenthesisDepth++;
-            depthToSet = parenthesisDepth;
+            openPairs.push_back(++uniqueId);
+            i.setDepth(openPairs.size());
+            i.setPairId(openPairs.back());
         } else if(i.isType(Token::TOKEN_CLOSE_PARENTHESIS)) {
-            parenthesisDepth--;
-        }
-        i.setDepth(depthToSet);
-        if(depthToSet > deepestParenthesis) {
-            deepestParenthesis = depthToSet;
-        }
-    }
-    //assign a globally unique id to each parenthesis pair, this is for hilighting of each unique pair
-    // ( ( () ), () )
-    // 0 1 22 1  11 0
-    // 0 1 22 1  33 0
-    
-    // This is horrible and is definitely doable in linear time...
-    int uniqueId = 0;
-    for(int i = 0; i < deepestParenthesis+1; i++) {
-        for(auto &t : list.list) {
-            if(t.getDepth() == i) {
-                int idToSet = uniqueId;
-                if(t.isType(Token::TOKEN_CLOSE_PARENTHESIS))
-                    uniqueId++;
-                t.setPairId(idToSet);
+            i.setDepth(openPairs.size());
+            i.setPairId(openPairs.empty() ? 0 : openPairs.back());
+            if(!openPairs.empty()) {
+                openPairs.pop_back();
             }
+        } else {
+            i.setDepth(openPairs.size());
+            i.setPairId(openPairs.empty() ? 0 : openPairs.back());
         }
     }
 }
@@ -465,12 +308,37 @@ bool Calculator::resultIsValid() {
 }
 
 double Calculator::executeInstructions() {
-    vm->execute(compiledInstructions);
-    if(vm->getStack()->empty()) {
-        reportError(new CalcError(Token(Token::TOKEN_EXPRESSION, parsed->toString()), "No result on stack"));
+    if(resultRegister < 0) {
         return 0.0;
     }
-    return vm->getResult();
+    if(jitProgram) {
+        vm->execute(*jitProgram);
+    } else {
+        vm->execute(*program);
+    }
+    return vm->getRegister(resultRegister);
+}
+
+void Calculator::executeBatch(int slot, const double* inputs, double* outputs, size_t count) {
+    if(resultRegister < 0) {
+        std::fill(outputs, outputs + count, 0.);
+        return;
+    }
+
+    size_t i = 0;
+    for(; i + BatchVM::lanes <= count; i += BatchVM::lanes) {
+        batchVm->executeBlock(compiledInstructions, registerCount, resultRegister, *vm, slot, inputs + i, outputs + i);
+    }
+    if(i < count) {
+        // The remainder runs as a block padded with its last input, so it leaves the VM's
+        // variables alone and treats a slot of -1 just like the full blocks do
+        double padded[BatchVM::lanes];
+        double results[BatchVM::lanes];
+        std::copy(inputs + i, inputs + count, padded);
+        std::fill(padded + (count - i), padded + BatchVM::lanes, inputs[count - 1]);
+        batchVm->executeBlock(compiledInstructions, registerCount, resultRegister, *vm, slot, padded, results);
+        std::copy(results, results + (count - i), outputs + i);
+    }
 }
 
 void Calculator::dumpInstructions() {
@@ -480,19 +348,17 @@ void Calculator::dumpInstructions() {
     }
 }
 
-std::shared_ptr<std::vector<CalcError*>> Calculator::getErrors() {
-    return std::make_shared<std::vector<CalcError*>>(errors);
+std::span<const CalcError> Calculator::getErrors() const {
+    return errors;
 }
 
-void Calculator::reportError(CalcError* error) {
-    errors.push_back(error);
+void Calculator::reportError(const Token& token, std::string_view source, const char* message) {
+    errors.emplace_back(token, arena->copy(token.getValue(source)), message);
     validResult = false;
 }
 
 void Calculator::clearErrors() {
-    for(auto &i: errors) {
-        delete i;
-    }
+    // Their text is released with the arena
     errors.clear();
 }
 
@@ -503,8 +369,8 @@ std::vector<std::string> Calculator::getSuggestions(std::string_view input) {
 
     //find functions that begin with input
     for(auto &i : Functions::getFunctions()) {
-        if(i.first.find(input) == 0) {
-            suggestions.push_back(i.first);
+        if(i.name.find(input) == 0) {
+            suggestions.push_back(i.name);
         }
     }
     //find constants that begin with input
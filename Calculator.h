@@ -4,53 +4,96 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <span>
+
+#include "CalcError.h"
 
 class Token;
 class TokenList;
 class Parser;
-class Lexer;
-class CalcError;
+class AstParser;
+class Ast;
+class Arena;
 class Instruction;
 class InstructionVM;
+class BatchVM;
+class JitProgram;
+class Program;
 
 class Calculator {
 public:
     Calculator(bool debug);
 
-    int getPrecedence(std::string_view in);
-    TokenList performShuntingYard(const TokenList& tokens);
-    double computeFunctionResult(const Token func);
-    double computeResult(const TokenList& outputQueue);
-
+    // Tokenizes, validates and compiles input in one pass, reporting errors as it goes.
+    // Returns immediately if input is unchanged since the last call, unchanged lines reuse their tokens
     void compileInput(std::string_view input);
-    void compileTokens(const TokenList& tokens, std::vector<Instruction>& instructions);
-    void compileFunctionCall(const Token func, std::vector<Instruction>& instructions, std::string &funcName);
+    // Returns the register holding the value of root, or -1 if nothing was compiled
+    int compileAst(const TokenList& tokens, const Ast& ast, int root, std::vector<Instruction>& instructions);
 
-    double processTokens(TokenList& list);
-    double calculateInput(std::string_view input);
     void setDebug(bool nDebug);
+    void setOptimize(bool nOptimize);
+    // Number of instructions removed by the optimizer in the last compileInput
+    int getRemovedInstructionCount() const;
+    // Translate compiled programs to native code, falls back to the VM where unsupported
+    void setJit(bool nJit);
+    bool isJitCompiled() const;
     
     void hintTokens(TokenList& list);
 
     void clearErrors();
-    void reportError(CalcError* error);
+    // Records an error against token, copying its text out of source
+    void reportError(const Token& token, std::string_view source, const char* message);
 
-    std::shared_ptr<std::vector<CalcError*>> getErrors();
-    std::vector<std::string> getSuggestions(std::string_view input);
+    // Valid until the next compilation
+    std::span<const CalcError> getErrors() const;
+    // Functions and constants whose names start with input, shortest first
+    static std::vector<std::string> getSuggestions(std::string_view input);
     std::vector<Instruction> compiledInstructions;
+    int registerCount;
+    int resultRegister;
 
     bool resultIsValid();
     TokenList* parsed;
 
+    // 0 if nothing was compiled, compileInput has reported why
     double executeInstructions();
+    // Evaluates the compiled program for count values of the variable in slot, in blocks of
+    // BatchVM::lanes with the last one padded. Like BatchVM, leaves the VM's variables unchanged
+    void executeBatch(int slot, const double* inputs, double* outputs, size_t count);
     void dumpInstructions();
 
     std::shared_ptr<Parser> parser;
-    std::shared_ptr<Lexer> lexer;
+    std::shared_ptr<AstParser> astParser;
     std::shared_ptr<InstructionVM> vm;
+    std::shared_ptr<BatchVM> batchVm;
+    // Backs compiler temporaries and errors, reset at the start of each compilation
+    std::shared_ptr<Arena> arena;
+    std::shared_ptr<JitProgram> jitProgram;
     bool isGraph;
+
+    // The last compiled program, empty unless it was verified. It is never modified once
+    // returned, so it can be executed from other threads while this Calculator compiles
+    // the next input. The Calculator itself is used from one thread.
+    std::shared_ptr<const Program> getProgram() const;
 private:
+    // compiledInstructions encoded for the interpreter
+    std::shared_ptr<Program> program;
+
     bool debug;
+    bool optimize;
+    bool jit;
+    int removedInstructionCount;
     bool validResult;
-    std::vector<CalcError*> errors;
+    // Cleared but never shrunk, so reporting errors does not allocate once warmed up
+    std::vector<CalcError> errors;
+
+    struct LineStages;
+    // Tokenizes and parses one line, or copies it from lineCache. False if the line has errors
+    bool parseLine(std::string_view line, LineStages& stages);
+
+    std::string compiledInput;
+    bool compiledInputIsCurrent;
+    // Lines of the last compiled input, reused when a line's text is unchanged
+    std::shared_ptr<std::vector<LineStages>> lineCache;
+    std::shared_ptr<std::vector<LineStages>> spareLineCache;
 };
\ No newline at end of file
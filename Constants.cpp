@@ -1,16 +1,29 @@
 #include "Constants.h"
 #include <math.h>
+#include <algorithm>
 
-bool Constants::exists(std::string name) {
-    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
-    return constants.find(name) != constants.end();
+namespace {
+    // There are only a handful of constants, a scan beats building an upper case key
+    const std::pair<const std::string, double>* findConstant(const std::map<std::string, double>& constants, std::string_view name) {
+        for(auto &i : constants) {
+            if(i.first.size() == name.size() && std::equal(name.begin(), name.end(), i.first.begin(), [](char a, char b) { return ::toupper((unsigned char)a) == b; })) {
+                return &i;
+            }
+        }
+        return nullptr;
+    }
 }
 
-double Constants::get(std::string name) {
-    return constants.at(name);
+bool Constants::exists(std::string_view name) {
+    return findConstant(constants, name) != nullptr;
 }
 
-const std::map<std::string, double> Constants::getConstants() {
+double Constants::get(std::string_view name) {
+    auto constant = findConstant(constants, name);
+    return constant ? constant->second : 0.;
+}
+
+const std::map<std::string, double>& Constants::getConstants() {
     return constants;
 }
 
@@ -2,12 +2,14 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 
 class Constants {
     public:
-    static bool exists(std::string name);
-    static double get(std::string name);
-    static const std::map<std::string, double> getConstants();
+    // Names are matched case insensitively
+    static bool exists(std::string_view name);
+    static double get(std::string_view name);
+    static const std::map<std::string, double>& getConstants();
     private:
     static const std::map<std::string, double> constants;
 };
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include "DynamicMesh.h"
+
+#include <glad/glad.h>
+
+DynamicMesh::DynamicMesh(const std::string& name, size_t capacity) :Mesh(name), vbo(0), capacity(capacity) {
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, capacity * floatsPerVertex * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, floatsPerVertex * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, floatsPerVertex * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    indexCount = 0;
+    built = true;
+}
+
+DynamicMesh::~DynamicMesh() {
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    // Deleting name 0 is ignored, should Mesh's destructor release the vertex array too
+    vao = 0;
+}
+
+void DynamicMesh::update(const std::vector<float>& vertices, size_t count) {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    if(count > capacity) {
+        capacity = count;
+        glBufferData(GL_ARRAY_BUFFER, capacity * floatsPerVertex * sizeof(float), vertices.data(), GL_DYNAMIC_DRAW);
+    } else if(count > 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * floatsPerVertex * sizeof(float), vertices.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    indexCount = count;
+}
+
+size_t DynamicMesh::getCapacity() const {
+    return capacity;
+}
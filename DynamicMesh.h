@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <AAGL/Mesh.h>
+
+// A Mesh whose vertices are rewritten in place, for geometry that changes while the
+// program runs. It creates its own vertex array and buffer rather than going through
+// Mesh::build, so it knows the buffer to update and its layout: interleaved X, Y, Z, S, T
+// floats, position at attribute 0 and texture coordinate at attribute 1, as build lays
+// out the same data. Draws with anything that draws a Mesh, Shape included.
+class DynamicMesh : public Mesh {
+    public:
+    static const size_t floatsPerVertex = 5;
+
+    // Allocates room for capacity vertices up front, drawing none
+    DynamicMesh(const std::string& name, size_t capacity);
+    ~DynamicMesh();
+    DynamicMesh(const DynamicMesh&) = delete;
+    DynamicMesh& operator=(const DynamicMesh&) = delete;
+
+    // Replaces the first count vertices and draws only those. The buffer is reallocated
+    // only when count exceeds its capacity
+    void update(const std::vector<float>& vertices, size_t count);
+    size_t getCapacity() const;
+
+    private:
+    unsigned int vbo;
+    size_t capacity;
+};
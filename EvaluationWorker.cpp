@@ -0,0 +1,143 @@
+#include "EvaluationWorker.h"
+#include "Calculator.h"
+#include "InstructionVM.h"
+#include "Instruction.h"
+#include "Program.h"
+#include "ThreadPool.h"
+
+EvaluationWorker::EvaluationWorker(std::function<void()> onPublish)
+    :onPublish(onPublish), calculator(std::make_shared<Calculator>(false)), sampler(std::make_shared<GraphSampler>(std::make_shared<ThreadPool>())),
+    requestVersion(0), hasRequest(false), idle(false), stopping(false), stale(false) {
+    calculator->setJit(true);
+    // Last, everything the thread touches is set up
+    thread = std::thread(&EvaluationWorker::run, this);
+}
+
+EvaluationWorker::~EvaluationWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stale.store(true, std::memory_order_relaxed);
+    wake.notify_one();
+    thread.join();
+}
+
+uint64_t EvaluationWorker::submit(std::string_view input, const GraphSampler::AdaptiveSettings& settings) {
+    uint64_t version;
+    bool wasIdle;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Replaces a request the worker hasn't started, keystrokes typed while it was busy
+        // are evaluated once, as the text they add up to
+        requestInput.assign(input);
+        requestSettings = settings;
+        requestSettings.cancel = nullptr;
+        version = ++requestVersion;
+        hasRequest = true;
+        stale.store(true, std::memory_order_relaxed);
+        wasIdle = idle;
+    }
+    // A busy worker finds the request when it's done, waking it costs the typing thread
+    if(wasIdle) {
+        wake.notify_one();
+    }
+    return version;
+}
+
+bool EvaluationWorker::poll() {
+    return results.take();
+}
+
+const Evaluation& EvaluationWorker::current() const {
+    return results.read();
+}
+
+void EvaluationWorker::run() {
+    std::string input;
+    GraphSampler::AdaptiveSettings settings;
+    uint64_t version;
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle = true;
+            wake.wait(lock, [this] { return hasRequest || stopping; });
+            idle = false;
+            if(stopping) {
+                return;
+            }
+            input.swap(requestInput);
+            settings = requestSettings;
+            version = requestVersion;
+            hasRequest = false;
+            // Under the lock, a submit after this point sets it again
+            stale.store(false, std::memory_order_relaxed);
+        }
+
+        bool sampling = evaluate(input, version, settings);
+        // Text goes out before the curve, which can take much longer
+        publish();
+        if(sampling && sample(settings)) {
+            publish();
+        }
+    }
+}
+
+bool EvaluationWorker::evaluate(const std::string& input, uint64_t version, const GraphSampler::AdaptiveSettings& settings) {
+    calculator->vm->reset();
+    calculator->compileInput(input);
+    latest.version = version;
+    latest.valid = calculator->resultIsValid();
+    latest.result = latest.valid ? calculator->executeInstructions() : 0.;
+    // Running can report an error too
+    latest.valid = calculator->resultIsValid();
+    latest.isGraph = calculator->isGraph;
+    latest.tokens = *calculator->parsed;
+
+    latest.errors.clear();
+    for(const auto& error : calculator->getErrors()) {
+        latest.errors.push_back({error.getToken(), std::string(error.getValue()), error.getMessage()});
+    }
+    latest.instructions.clear();
+    for(const auto& instruction : calculator->compiledInstructions) {
+        latest.instructions.push_back(instruction.toString());
+    }
+
+    std::shared_ptr<const Program> program = calculator->getProgram();
+    if(!latest.valid || !latest.isGraph || program->getResultRegister() < 0) {
+        latest.hasCurve = false;
+        return false;
+    }
+    // An edit that compiles to the same program, or a keystroke that doesn't change
+    // anything, keeps the curve already sampled
+    uint64_t hash = GraphSampler::curveHash(*program, program->findSlot("x"), settings);
+    if(latest.hasCurve && latest.curveHash == hash) {
+        return false;
+    }
+    latest.hasCurve = false;
+    latest.curveHash = hash;
+    return true;
+}
+
+bool EvaluationWorker::sample(const GraphSampler::AdaptiveSettings& settings) {
+    std::shared_ptr<const Program> program = calculator->getProgram();
+    GraphSampler::AdaptiveSettings cancellable = settings;
+    cancellable.cancel = &stale;
+    sampler->sampleAdaptive(*program, program->findSlot("x"), cancellable, latest.xs, latest.ys);
+    // A newer input is waiting, its evaluation replaces this one, so a partial curve is
+    // never shown
+    if(stale.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    latest.hasCurve = true;
+    return true;
+}
+
+void EvaluationWorker::publish() {
+    // Copying into the back buffer reuses the allocations of what it held before
+    results.write() = latest;
+    results.publish();
+    if(onPublish) {
+        onPublish();
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+#include "Token.h"
+#include "TokenList.h"
+#include "GraphSampler.h"
+#include "TripleBuffer.h"
+
+class Calculator;
+
+// Everything the front end shows for one input, owned outright so it can cross threads
+struct Evaluation {
+    // A CalcError with its text copied, the original points into the Calculator
+    struct Error {
+        Token token;
+        std::string value;
+        // A string literal
+        std::string_view message;
+    };
+
+    // Of the submit this answers, 0 before the first
+    uint64_t version = 0;
+    TokenList tokens;
+    std::vector<Error> errors;
+    // compiledInstructions as text
+    std::vector<std::string> instructions;
+    bool valid = false;
+    bool isGraph = false;
+    double result = 0;
+
+    // Set once the curve for this input and the submitted settings is in xs and ys.
+    // A graph's first publish comes before sampling so text shows without waiting on it
+    bool hasCurve = false;
+    // GraphSampler::curveHash of the curve
+    uint64_t curveHash = 0;
+    std::vector<double> xs;
+    std::vector<double> ys;
+};
+
+// Compiles, runs and samples input on a thread of its own, so the thread handling keys
+// never waits on evaluation. Inputs submitted while the worker is busy replace each other
+// and only the latest is evaluated, a newer submit also cancels sampling for an older one.
+// Results are published through a TripleBuffer, poll never blocks.
+class EvaluationWorker {
+    public:
+    // onPublish runs on the worker thread after each publish, for waking the consumer
+    explicit EvaluationWorker(std::function<void()> onPublish = {});
+    ~EvaluationWorker();
+    EvaluationWorker(const EvaluationWorker&) = delete;
+    EvaluationWorker& operator=(const EvaluationWorker&) = delete;
+
+    // Queues input for evaluation with graphs sampled over settings, returns its version.
+    // settings.cancel is ignored, the worker sets its own
+    uint64_t submit(std::string_view input, const GraphSampler::AdaptiveSettings& settings);
+    // Moves current() to the latest published evaluation, returns whether there was a new one
+    bool poll();
+    // Unchanged until the next poll
+    const Evaluation& current() const;
+
+    private:
+    void run();
+    // Compiles and runs input into latest, returns whether a curve is left to sample
+    bool evaluate(const std::string& input, uint64_t version, const GraphSampler::AdaptiveSettings& settings);
+    // Samples latest's program into its curve, returns false if cancelled part way
+    bool sample(const GraphSampler::AdaptiveSettings& settings);
+    void publish();
+
+    std::function<void()> onPublish;
+
+    // Used by the worker thread only
+    std::shared_ptr<Calculator> calculator;
+    std::shared_ptr<GraphSampler> sampler;
+    // The evaluation being built, its curve is kept while the input's curve is unchanged
+    Evaluation latest;
+
+    TripleBuffer<Evaluation> results;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    // The latest submit, waiting if hasRequest is set
+    std::string requestInput;
+    GraphSampler::AdaptiveSettings requestSettings;
+    uint64_t requestVersion;
+    bool hasRequest;
+    // Set while the worker waits for a request
+    bool idle;
+    bool stopping;
+    // Set by submit, tells the worker its current evaluation is out of date
+    std::atomic<bool> stale;
+
+    std::thread thread;
+};
@@ -0,0 +1,37 @@
+#include "ExecutionContext.h"
+#include "Program.h"
+
+#include <algorithm>
+#include <new>
+#include <limits>
+
+ExecutionContext::ExecutionContext() :registers(nullptr), variables(nullptr), capacity(0) {
+}
+
+ExecutionContext::~ExecutionContext() {
+    ::operator delete[](registers, std::align_val_t(cacheLine));
+}
+
+void ExecutionContext::prepare(const Program& program) {
+    const size_t perLine = cacheLine / sizeof(double);
+    size_t registerCount = program.getRegisterCount();
+    size_t needed = (registerCount + program.getVariableCount() + perLine - 1) / perLine * perLine;
+
+    if(capacity < needed) {
+        ::operator delete[](registers, std::align_val_t(cacheLine));
+        registers = static_cast<double*>(::operator new[](needed * sizeof(double), std::align_val_t(cacheLine)));
+        capacity = needed;
+    }
+    variables = registers + registerCount;
+    std::fill(registers, registers + capacity, 0.);
+}
+
+double ExecutionContext::execute(const Program& program) {
+    // An empty program, what getProgram returns for input that failed to compile, has no
+    // result register and maybe no storage
+    if(program.getResultRegister() < 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    program.execute(registers, variables);
+    return registers[program.getResultRegister()];
+}
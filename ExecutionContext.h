@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+
+class Program;
+
+// The mutable state of one evaluation: registers and variable slots, nothing else.
+// Programs are immutable, so each thread evaluates a shared program through a context
+// of its own. Contexts and their storage start on a cache line and are padded to a whole
+// number of them, so contexts used by different threads never share a line.
+class alignas(64) ExecutionContext {
+    public:
+    static const size_t cacheLine = 64;
+
+    ExecutionContext();
+    ~ExecutionContext();
+    ExecutionContext(const ExecutionContext&) = delete;
+    ExecutionContext& operator=(const ExecutionContext&) = delete;
+
+    // Sizes the storage for program, only allocating when it grows, and zeroes the variables
+    void prepare(const Program& program);
+
+    // Slots come from Program::findSlot, program must have been prepared
+    void setVar(int slot, double value) {
+        variables[slot] = value;
+    }
+    double getVar(int slot) const {
+        return variables[slot];
+    }
+
+    // Runs a prepared program and returns its result, NaN for an empty program
+    double execute(const Program& program);
+
+    private:
+    double* registers;
+    double* variables;
+    // Doubles in the allocation holding both
+    size_t capacity;
+};
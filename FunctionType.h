@@ -1,9 +1,25 @@
+#pragma once
+
 #include <vector>
-#include <map>
-#include <tuple>
-#include <functional>
-
-typedef std::vector<double> ParameterList_t;
-typedef std::function<double(ParameterList_t)> Function_t;
-typedef std::pair<Function_t, int> FunctionCallDefinition_t;
-typedef const std::map<std::string, FunctionCallDefinition_t> FunctionList_t;
\ No newline at end of file
+#include <string>
+
+typedef double (*Function1_t)(double);
+typedef double (*Function2_t)(double, double);
+typedef double (*Function3_t)(double, double, double);
+
+// A builtin function, called through the pointer matching its arity
+struct FunctionDefinition_t {
+    FunctionDefinition_t(std::string name, Function1_t function) :name(name), arity(1), f1(function) {}
+    FunctionDefinition_t(std::string name, Function2_t function) :name(name), arity(2), f2(function) {}
+    FunctionDefinition_t(std::string name, Function3_t function) :name(name), arity(3), f3(function) {}
+
+    std::string name;
+    int arity;
+    // Pure functions depend only on their arguments and may be folded at compile time
+    bool pure = true;
+    Function1_t f1 = nullptr;
+    Function2_t f2 = nullptr;
+    Function3_t f3 = nullptr;
+};
+
+typedef const std::vector<FunctionDefinition_t> FunctionList_t;
@@ -1,21 +1,31 @@
 #pragma once
 
 #include <vector>
-#include <functional>
 #include <map>
 #include <string>
 #include <string_view>
-#include <tuple>
 
 #include "FunctionType.h"
 
 class Functions {
     public:
-    static FunctionList_t getFunctions();
-    static bool exists(std::string name);
-    static FunctionCallDefinition_t get(std::string name);
-    static FunctionCallDefinition_t* getPtr(std::string name);
+    static FunctionList_t& getFunctions();
+    static bool exists(std::string_view name);
+
+    // Returns the function id used by compiled instructions, or -1 if name isn't a function
+    static int find(std::string_view name);
+
+    static const FunctionDefinition_t& get(int id) {
+        return functions[id];
+    }
+
+    // Calls function id with args[0..arity)
+    static double call(int id, const double* args);
+
+    // sin and cos of the same argument in one call, results match sin() and cos()
+    static void sinCos(double a, double& sinResult, double& cosResult);
 
     private:
     static FunctionList_t functions;
-};
\ No newline at end of file
+    static const std::map<std::string, int, std::less<>> ids;
+};
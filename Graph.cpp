@@ -4,15 +4,26 @@
 #include <GLFW/glfw3.h>
 
 #include <AAGL/Graphics.h>
-#include <AAGL/Mesh.h>
 #include <AAGL/Shape.h>
-#include "Helper.h"
+#include "RenderHelper.h"
+#include "DynamicMesh.h"
+
+#include <algorithm>
+
+// Cap on samples per curve, the vertex buffer is allocated for this many up front
+static const size_t maxSamples = 4096;
 
 Graph:: Graph(Graphics* graphics, float x, float y, float w, float h) :graphics(graphics), x(x), y(y), w(w), h(h) {
-    mesh = new Mesh("graph");
+    mesh = new DynamicMesh("graph", maxSamples);
     graphShape = new Shape(graphics, mesh);
     graphShape->drawType = GL_LINE_STRIP;
     graphShape->col = glm::vec4(1., 1., 1., 1.);
+    left = -1.;
+    right = 1.;
+    bottom = -1.;
+    top = 1.;
+    sampledHash = 0;
+    sampled = false;
     recalculateView();
 }
 
@@ -21,12 +32,51 @@ Graph::~Graph() {
     delete graphShape;
 }
 
-void Graph::addData(std::vector<float> &data) {
-    mesh->build(data);
+void Graph::setViewport(double left, double right, double bottom, double top) {
+    this->left = left;
+    this->right = right;
+    this->bottom = bottom;
+    this->top = top;
+}
+
+GraphSampler::AdaptiveSettings Graph::getSamplingSettings() {
+    // Dense where the curve bends, sparse where a line is indistinguishable from it
+    GraphSampler::AdaptiveSettings settings;
+    settings.start = left;
+    settings.end = right;
+    // Half a pixel
+    settings.tolerance = (top - bottom) / std::max(h, 1.f) / 2.;
+    // A sample every 4 pixels to start with, so narrow features aren't stepped over
+    settings.initialIntervals = std::max(1, (int)w / 4);
+    settings.maxEvaluations = maxSamples;
+    // Interval bounds stop refinement where the curve has left the view
+    settings.bottom = bottom;
+    settings.top = top;
+    return settings;
+}
+
+void Graph::setSamples(uint64_t hash, const std::vector<double>& xs, const std::vector<double>& ys) {
+    if(sampled && hash == sampledHash) {
+        return;
+    }
+    sampledHash = hash;
+    sampled = true;
+
+    // Viewport to -1..1, which the view maps onto the graph's rectangle with y down
+    vertices.clear();
+    for(size_t i = 0; i < xs.size(); ++i) {
+        vertices.push_back((xs[i] - left) / (right - left) * 2. - 1.); //x
+        vertices.push_back(1. - (ys[i] - bottom) / (top - bottom) * 2.); //y
+        vertices.push_back(0); //z
+        vertices.push_back(0); //s
+        vertices.push_back(0); //t
+    }
+    // Written over the previous curve in place
+    mesh->update(vertices, xs.size());
 }
 
 void Graph::render(glm::mat4 projection) {
-    if(mesh->built) {
+    if(!vertices.empty()) {
         graphShape->render(projection);   
     }
 }
@@ -56,5 +106,5 @@ float Graph::getH() {
 }
 
 void Graph::recalculateView() {
-    graphShape->view = Helper::quadMat(w/2. + x, h/2. + y, w/2., h/2.);
-}
\ No newline at end of file
+    graphShape->view = RenderHelper::quadMat(w/2. + x, h/2. + y, w/2., h/2.);
+}
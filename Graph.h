@@ -1,18 +1,30 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
-class Mesh;
+#include "GraphSampler.h"
+
+class DynamicMesh;
 class Shape;
 class Graphics;
 
+// Plots a curve sampled elsewhere over a viewport. The graph describes the sampling its
+// viewport and size need and uploads a curve only when its hash differs from the one it
+// shows, writing it over the old one in a vertex buffer sized for the most samples it takes.
 class Graph {
 public:
     Graph(Graphics* graphics, float x, float y, float w, float h);
     ~Graph();
-    void addData(std::vector<float> &data);
+    // Range of x and y shown, -1 to 1 in both by default
+    void setViewport(double left, double right, double bottom, double top);
+    // How to sample a curve for the current viewport and size
+    GraphSampler::AdaptiveSettings getSamplingSettings();
+    // Shows the curve through xs and ys, uploading it unless hash matches the curve shown
+    void setSamples(uint64_t hash, const std::vector<double>& xs, const std::vector<double>& ys);
     void render(glm::mat4 projection);
     void setDimensions(float x, float y, float w, float h);
     float getX();
@@ -21,12 +33,23 @@ public:
     float getH();
 private:
     void recalculateView();
-    
-    Mesh* mesh;
+
+    DynamicMesh* mesh;
     Shape* graphShape;
     Graphics* graphics;
     float x;
     float y;
     float w;
     float h;
-};
\ No newline at end of file
+
+    double left;
+    double right;
+    double bottom;
+    double top;
+
+    // Of the curve in the vertex buffer, valid once sampled is set
+    uint64_t sampledHash;
+    bool sampled;
+    // Of the curve shown, kept between uploads so they don't allocate
+    std::vector<float> vertices;
+};
@@ -0,0 +1,184 @@
+#include "GraphSampler.h"
+#include "ThreadPool.h"
+#include "ExecutionContext.h"
+#include "IntervalContext.h"
+#include "Program.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstring>
+
+GraphSampler::GraphSampler(std::shared_ptr<ThreadPool> pool, size_t chunkSize)
+    :pool(pool), chunkSize(chunkSize), contexts(std::make_unique<ExecutionContext[]>(pool->getParticipantCount())),
+    intervalContexts(std::make_unique<IntervalContext[]>(pool->getParticipantCount())) {
+}
+
+GraphSampler::~GraphSampler() {
+}
+
+void GraphSampler::sample(const Program& program, int slot, const double* inputs, double* outputs, size_t count) {
+    for(int i = 0; i < pool->getParticipantCount(); ++i) {
+        contexts[i].prepare(program);
+    }
+
+    pool->parallelFor(count, chunkSize, [&](size_t begin, size_t end, int participant) {
+        ExecutionContext& context = contexts[participant];
+        for(size_t i = begin; i < end; ++i) {
+            if(slot >= 0) {
+                context.setVar(slot, inputs[i]);
+            }
+            outputs[i] = context.execute(program);
+        }
+    });
+}
+
+void GraphSampler::sampleBounds(const Program& program, int slot, const Interval* inputs, Interval* outputs, size_t count) {
+    for(int i = 0; i < pool->getParticipantCount(); ++i) {
+        intervalContexts[i].prepare(program);
+    }
+
+    pool->parallelFor(count, chunkSize, [&](size_t begin, size_t end, int participant) {
+        IntervalContext& context = intervalContexts[participant];
+        for(size_t i = begin; i < end; ++i) {
+            if(slot >= 0) {
+                context.setVar(slot, inputs[i]);
+            }
+            outputs[i] = context.execute(program);
+        }
+    });
+}
+
+void GraphSampler::cullSegments(const Program& program, int slot, const AdaptiveSettings& settings, const std::vector<double>& xs, const std::vector<double>& ys, std::vector<Segment>& segments) {
+    // Bounds cost several point evaluations, so only segments that look out of view or
+    // undefined from their ends are checked, those are where refinement runs away
+    boxes.clear();
+    for(auto &i : segments) {
+        double y0 = ys[i.left];
+        double y1 = ys[i.left + 1];
+        if((y0 > settings.top && y1 > settings.top) || (y0 < settings.bottom && y1 < settings.bottom) || !std::isfinite(y0) || !std::isfinite(y1)) {
+            boxes.push_back(Interval::range(xs[i.left], xs[i.left + 1]));
+        }
+    }
+    bounds.resize(boxes.size());
+    sampleBounds(program, slot, boxes.data(), bounds.data(), boxes.size());
+
+    // Both ends of a segment are within its bound, so the line between them is too
+    size_t kept = 0;
+    size_t checked = 0;
+    for(size_t i = 0; i < segments.size(); ++i) {
+        if(checked < boxes.size() && boxes[checked].lo == xs[segments[i].left]) {
+            const Interval& bound = bounds[checked++];
+            bool hidden = bound.isEmpty() || bound.lo > settings.top || bound.hi < settings.bottom;
+            bool flat = bound.hi - bound.lo <= settings.tolerance;
+            if(hidden || flat) {
+                continue;
+            }
+        }
+        segments[kept++] = segments[i];
+    }
+    segments.resize(kept);
+}
+
+// Distance of the midpoint from the chord. A curve that is finite at some of the three points
+// and not at others has an edge of its domain inside the segment, which is worth locating.
+static double midpointDeviation(double y0, double yMid, double y1) {
+    bool finite0 = std::isfinite(y0);
+    bool finiteMid = std::isfinite(yMid);
+    bool finite1 = std::isfinite(y1);
+    if(finite0 && finiteMid && finite1) {
+        return std::fabs(yMid - (y0 + y1) * .5);
+    }
+    if(finite0 || finiteMid || finite1) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return 0.;
+}
+
+size_t GraphSampler::sampleAdaptive(const Program& program, int slot, const AdaptiveSettings& settings, std::vector<double>& xs, std::vector<double>& ys) {
+    // The initial grid counts against the cap too, but always has both ends
+    size_t intervals = std::clamp<size_t>(settings.initialIntervals, 1, std::max<size_t>(settings.maxEvaluations, 2) - 1);
+    xs.resize(intervals + 1);
+    ys.resize(intervals + 1);
+    for(size_t i = 0; i <= intervals; ++i) {
+        xs[i] = settings.start + (settings.end - settings.start) * i / intervals;
+    }
+    xs[intervals] = settings.end;
+    sample(program, slot, xs.data(), ys.data(), xs.size());
+    size_t evaluations = xs.size();
+
+    pending.clear();
+    for(size_t i = 0; i < intervals; ++i) {
+        pending.push_back({i, 0, 0.});
+    }
+    if(settings.cull) {
+        cullSegments(program, slot, settings, xs, ys, pending);
+    }
+
+    while(!pending.empty() && evaluations < settings.maxEvaluations && !(settings.cancel && settings.cancel->load(std::memory_order_relaxed))) {
+        size_t budget = settings.maxEvaluations - evaluations;
+        if(pending.size() > budget) {
+            std::partial_sort(pending.begin(), pending.begin() + budget, pending.end(), [](const Segment& a, const Segment& b) {
+                return a.deviation > b.deviation;
+            });
+            pending.resize(budget);
+            std::sort(pending.begin(), pending.end(), [](const Segment& a, const Segment& b) {
+                return a.left < b.left;
+            });
+        }
+
+        midXs.resize(pending.size());
+        midYs.resize(pending.size());
+        for(size_t i = 0; i < pending.size(); ++i) {
+            midXs[i] = (xs[pending[i].left] + xs[pending[i].left + 1]) * .5;
+        }
+        sample(program, slot, midXs.data(), midYs.data(), midXs.size());
+        evaluations += midXs.size();
+
+        // Merge the midpoints in after their segment's first sample, both halves of a
+        // segment that strayed too far are tested in the next round
+        mergedXs.clear();
+        mergedYs.clear();
+        next.clear();
+        size_t midpoint = 0;
+        for(size_t i = 0; i < xs.size(); ++i) {
+            mergedXs.push_back(xs[i]);
+            mergedYs.push_back(ys[i]);
+            if(midpoint < pending.size() && pending[midpoint].left == i) {
+                double deviation = midpointDeviation(ys[i], midYs[midpoint], ys[i + 1]);
+                int depth = pending[midpoint].depth + 1;
+                if(deviation > settings.tolerance && depth < settings.maxDepth) {
+                    next.push_back({mergedXs.size() - 1, depth, deviation});
+                    next.push_back({mergedXs.size(), depth, deviation});
+                }
+                mergedXs.push_back(midXs[midpoint]);
+                mergedYs.push_back(midYs[midpoint]);
+                midpoint++;
+            }
+        }
+        std::swap(xs, mergedXs);
+        std::swap(ys, mergedYs);
+        std::swap(pending, next);
+        if(settings.cull) {
+            cullSegments(program, slot, settings, xs, ys, pending);
+        }
+    }
+
+    return evaluations;
+}
+
+uint64_t GraphSampler::curveHash(const Program& program, int slot, const AdaptiveSettings& settings) {
+    // FNV-1a over the program's hash and every setting that shapes the samples
+    uint64_t words[] = {program.hash(), (uint64_t)slot, 0, 0, 0, (uint64_t)settings.initialIntervals, (uint64_t)settings.maxEvaluations,
+        (uint64_t)settings.maxDepth, 0, 0, (uint64_t)settings.cull};
+    std::memcpy(&words[2], &settings.start, sizeof(double));
+    std::memcpy(&words[3], &settings.end, sizeof(double));
+    std::memcpy(&words[4], &settings.tolerance, sizeof(double));
+    std::memcpy(&words[8], &settings.bottom, sizeof(double));
+    std::memcpy(&words[9], &settings.top, sizeof(double));
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(uint64_t word : words) {
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+}
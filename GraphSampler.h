@@ -0,0 +1,92 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <atomic>
+
+class Program;
+class ThreadPool;
+class ExecutionContext;
+class IntervalContext;
+struct Interval;
+
+// Evaluates a program for many values of one variable on a ThreadPool. Each participant
+// evaluates its chunks through its own ExecutionContext and writes straight into the
+// output, so the results are bit-identical to evaluating the samples one after another.
+class GraphSampler {
+    public:
+    // Samples per chunk, enough to amortize taking a chunk while leaving work to steal
+    static const size_t defaultChunkSize = 64;
+
+    explicit GraphSampler(std::shared_ptr<ThreadPool> pool, size_t chunkSize = defaultChunkSize);
+    ~GraphSampler();
+
+    // outputs[i] = program evaluated with variable slot set to inputs[i], other variables
+    // start at 0. slot comes from Program::findSlot, -1 evaluates every sample the same.
+    void sample(const Program& program, int slot, const double* inputs, double* outputs, size_t count);
+    // The same over ranges of the variable, through IntervalContext
+    void sampleBounds(const Program& program, int slot, const Interval* inputs, Interval* outputs, size_t count);
+
+    struct AdaptiveSettings {
+        double start = -1.;
+        double end = 1.;
+        // How far the curve may stray from the line drawn between two samples, in y units.
+        // For a view of height h pixels spanning 2 units, half a pixel is 1 / h.
+        double tolerance = 1e-3;
+        // Uniform intervals sampled before any subdivision, enough to catch features wider
+        // than a fraction of the view
+        size_t initialIntervals = 128;
+        // Samples evaluated at most, the initial grid included, never fewer than the two ends
+        size_t maxEvaluations = 4096;
+        // Most times an initial interval is halved
+        int maxDepth = 16;
+        // The rows in view. With cull set, segments that look out of view or undefined are
+        // only halved while their interval bound says the curve may be in view and may
+        // stray further than the tolerance
+        double bottom = -std::numeric_limits<double>::infinity();
+        double top = std::numeric_limits<double>::infinity();
+        bool cull = true;
+        // Checked between rounds, once set sampling stops and returns what it has
+        const std::atomic<bool>* cancel = nullptr;
+
+        bool operator==(const AdaptiveSettings& other) const = default;
+    };
+
+    // Samples from start to end, halving segments whose midpoint is further than the
+    // tolerance from the line between their ends, most deviating first when the budget
+    // runs out. Each round of midpoints is evaluated as one batch on the pool. xs and ys
+    // are replaced with the samples in increasing x, returns the number of evaluations,
+    // not counting those of the interval bounds.
+    size_t sampleAdaptive(const Program& program, int slot, const AdaptiveSettings& settings, std::vector<double>& xs, std::vector<double>& ys);
+    // Identifies the samples sampleAdaptive takes, the same for a recompiled identical program
+    static uint64_t curveHash(const Program& program, int slot, const AdaptiveSettings& settings);
+
+    private:
+    struct Segment {
+        size_t left;            // Index of the segment's first sample
+        int depth;
+        double deviation;       // Of the parent, refines the worst segments first
+    };
+
+    // Drops segments whose curve is proven out of view, or within tolerance of any line
+    // through its ends
+    void cullSegments(const Program& program, int slot, const AdaptiveSettings& settings, const std::vector<double>& xs, const std::vector<double>& ys, std::vector<Segment>& segments);
+
+    std::shared_ptr<ThreadPool> pool;
+    size_t chunkSize;
+    // One per pool participant
+    std::unique_ptr<ExecutionContext[]> contexts;
+    std::unique_ptr<IntervalContext[]> intervalContexts;
+
+    // Kept between calls so adaptive sampling stops allocating once warmed up
+    std::vector<Segment> pending;
+    std::vector<Segment> next;
+    std::vector<double> midXs;
+    std::vector<double> midYs;
+    std::vector<double> mergedXs;
+    std::vector<double> mergedYs;
+    std::vector<Interval> boxes;
+    std::vector<Interval> bounds;
+};
@@ -1,17 +1,15 @@
 #include "Helper.h"
-#include <sstream>
-#include <iomanip>
-#include <limits>
+#include <charconv>
 
-std::string Helper::toStringWithMaximumPrecision(double value) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(std::numeric_limits<double>::digits10) << value;
-    return oss.str();
+std::string Helper::toShortestString(double value) {
+    char buffer[32];
+    return std::string(toShortestChars(value, buffer, sizeof(buffer)));
 }
 
-glm::mat4 Helper::quadMat(float x, float y, float w, float h) {
-    glm::mat4 mat = glm::mat4(1.0f);
-    mat = glm::translate(mat, glm::vec3(x, y, 0.0f));
-    mat = glm::scale(mat, glm::vec3(w, h, 1.0f));
-    return mat;
-}
\ No newline at end of file
+std::string_view Helper::toShortestChars(double value, char* buffer, size_t size) {
+    auto [end, error] = std::to_chars(buffer, buffer + size, value);
+    if(error != std::errc()) {
+        return {};
+    }
+    return std::string_view(buffer, end - buffer);
+}
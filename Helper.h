@@ -1,11 +1,12 @@
 #pragma once
 
 #include <string>
-#include <glm/glm.hpp>
-#include <glm/ext.hpp>
+#include <string_view>
 
 class Helper {
     public:
-    static std::string toStringWithMaximumPrecision(double value);
-    static glm::mat4 quadMat(float x, float y, float w, float h);
-};
\ No newline at end of file
+    // Shortest text that parses back to exactly value
+    static std::string toShortestString(double value);
+    // Same as toShortestString but into buffer, returns the written part
+    static std::string_view toShortestChars(double value, char* buffer, size_t size);
+};
@@ -1,36 +1,32 @@
-#include <math.h>
 #include <sstream>
+#include <math.h>
 
 #include "Instruction.h"
-#include "FunctionType.h"
 #include "Functions.h"
-#include "InstructionVM.h"
+#include "Helper.h"
 
-Instruction::Instruction(int operation, Operand operand) :operation(operation), operand(operand) {
+Instruction::Instruction(int operation, int dst, int a, int b, int c, Operand operand)
+    :operation(operation), dst(dst), a(a), b(b), c(c), operand(operand) {
 }
 
-Operand::Operand(int type, double value) :type(type), value(value) {
+Operand::Operand() :type(Operand::TYPE_NONE), value(0.), functionId(-1) {
 }
 
-Operand::Operand(int type, std::string name) :type(type), name(name) {
+Operand::Operand(int type, double value) :type(type), value(value), functionId(-1) {
 }
 
-Operand::Operand(int type, char operatorSymbol) :type(type), operatorSymbol(operatorSymbol) {
+Operand::Operand(int type, std::string name) :type(type), value(0.), name(name), functionId(-1) {
 }
 
-double Operand::getValue(InstructionVM* vm) const {
-    if(type == Operand::TYPE_VARIABLE) {
-        return vm->getVar(name);
-    }
-    return value;
+Operand::Operand(int type, int functionId) :type(type), value(0.), functionId(functionId) {
 }
 
-std::string Operand::getName() const {
-    return name;
+int Operand::getType() const {
+    return type;
 }
 
-char Operand::getOperatorSymbol() const {
-    return operatorSymbol;
+std::string Operand::getName() const {
+    return name;
 }
 
 std::string Operand::toString() const {
@@ -38,95 +34,178 @@ std::string Operand::toString() const {
 
     switch(type) {
         case Operand::TYPE_NUMBER:
-            str << value;
+            str << Helper::toShortestString(value);
             break;
         case Operand::TYPE_VARIABLE:
             str << name;
             break;
         case Operand::TYPE_FUNCTION:
-            str << name;
-            break;
-        case Operand::TYPE_OPERATOR:
-            str << operatorSymbol;
+            str << Functions::get(functionId).name;
             break;
     }
 
     return str.str();
 }
 
-std::string Instruction::toString() const {
-    std::string str = "";
-
-    switch(operation) {
-        case Instruction::OP_PUSH:
-            str += "PUSH ";
-            break;
-        case Instruction::OP_OPERATOR:
-            str += "OPERATOR ";
-            break;
-        case Instruction::OP_CALL:
-            str += "CALL ";
-            break;
+int Instruction::operationFromOperator(char symbol) {
+    switch(symbol) {
+        case '+': return Instruction::OP_ADD;
+        case '-': return Instruction::OP_SUB;
+        case '*': return Instruction::OP_MUL;
+        case '/': return Instruction::OP_DIV;
+        case '^': return Instruction::OP_POW;
+        case '%': return Instruction::OP_MOD;
     }
+    return -1;
+}
 
-    return str + operand.toString();
+bool Instruction::isBinaryOperation(int operation) {
+    return operation >= Instruction::OP_ADD && operation <= Instruction::OP_MOD;
 }
 
-void Instruction::executeOperator(std::stack<Operand>& stack, InstructionVM* vm) {
-    auto rParam = stack.top();
-    stack.pop();
-    auto lParam = stack.top();
-    stack.pop();
+bool Instruction::isImmediateOperation(int operation) {
+    return operation >= Instruction::OP_ADDK && operation <= Instruction::OP_KDIV;
+}
 
-    double a = lParam.getValue(vm);
-    double b = rParam.getValue(vm);
+int Instruction::getSources(int sources[3]) const {
+    switch(operation) {
+        case Instruction::OP_LOAD_CONSTANT:
+        case Instruction::OP_LOAD_VARIABLE:
+            return 0;
+        case Instruction::OP_STORE_VARIABLE:
+        case Instruction::OP_CALL1:
+        case Instruction::OP_SINCOS:
+            sources[0] = a;
+            return 1;
+        case Instruction::OP_CALL2:
+            sources[0] = a;
+            sources[1] = b;
+            return 2;
+        case Instruction::OP_CALL3:
+        case Instruction::OP_MULADD:
+            sources[0] = a;
+            sources[1] = b;
+            sources[2] = c;
+            return 3;
+    }
 
-    switch(operand.getOperatorSymbol()) {
-        case '+':
-            stack.push(Operand(Operand::TYPE_NUMBER, a + b));
-            break;
-        case '-':
-            stack.push(Operand(Operand::TYPE_NUMBER, a - b));
-            break;
-        case '*':
-            stack.push(Operand(Operand::TYPE_NUMBER, a * b));
-            break;
-        case '/':
-            stack.push(Operand(Operand::TYPE_NUMBER, a / b));
-            break;
-        case '^':
-            stack.push(Operand(Operand::TYPE_NUMBER, pow(a, b)));
-            break;
-        case '%':
-            stack.push(Operand(Operand::TYPE_NUMBER, fmod(a, b)));
-            break;
-        case '=':
-            vm->setVar(lParam.getName(), b);
-            stack.push(Operand(Operand::TYPE_NUMBER, (double)(b)));
-            break;
+    if(isBinaryOperation(operation)) {
+        sources[0] = a;
+        sources[1] = b;
+        return 2;
     }
+    if(isImmediateOperation(operation)) {
+        sources[0] = a;
+        return 1;
+    }
+    return 0;
 }
 
-void Instruction::executeFunctionCall(std::stack<Operand>& stack, InstructionVM* vm) {
-    auto func = Functions::get(operand.getName());
-    ParameterList_t params;
-    for(int i = 0; i < func.second; i++) {
-        params.push_back(stack.top().getValue(vm));
-        stack.pop();
+int Instruction::getDestinations(int destinations[2]) const {
+    switch(operation) {
+        case Instruction::OP_STORE_VARIABLE:
+            return 0;
+        case Instruction::OP_SINCOS:
+            destinations[0] = dst;
+            destinations[1] = b;
+            return 2;
     }
-    stack.push(Operand(Operand::TYPE_NUMBER,func.first(params)));
+    destinations[0] = dst;
+    return 1;
 }
 
-void Instruction::execute(std::stack<Operand>& stack, InstructionVM* vm) {
+double Instruction::evaluate(int operation, double a, double b) {
     switch(operation) {
-        case Instruction::OP_PUSH:
-            stack.push(operand);
-            break;
-        case Instruction::OP_OPERATOR:
-            executeOperator(stack, vm);
-            break;
-        case Instruction::OP_CALL:
-            executeFunctionCall(stack, vm);
-            break;
+        case Instruction::OP_ADD: return a + b;
+        case Instruction::OP_SUB: return a - b;
+        case Instruction::OP_MUL: return a * b;
+        case Instruction::OP_DIV: return a / b;
+        case Instruction::OP_POW: return pow(a, b);
+        case Instruction::OP_MOD: return fmod(a, b);
     }
-}
\ No newline at end of file
+    return 0.;
+}
+
+int Instruction::getOperation() const {
+    return operation;
+}
+
+int Instruction::getDst() const {
+    return dst;
+}
+
+int Instruction::getA() const {
+    return a;
+}
+
+int Instruction::getB() const {
+    return b;
+}
+
+int Instruction::getC() const {
+    return c;
+}
+
+const Operand& Instruction::getOperand() const {
+    return operand;
+}
+
+std::string Instruction::toString() const {
+    std::string r = "r" + std::to_string(dst);
+    std::string ra = "r" + std::to_string(a);
+    std::string rb = "r" + std::to_string(b);
+
+    switch(operation) {
+        case Instruction::OP_LOAD_CONSTANT:
+            return "LOAD " + r + ", " + operand.toString();
+        case Instruction::OP_LOAD_VARIABLE:
+            return "LOADVAR " + r + ", " + operand.toString();
+        case Instruction::OP_STORE_VARIABLE:
+            return "STOREVAR " + operand.toString() + ", " + ra;
+        case Instruction::OP_ADD:
+            return "ADD " + r + ", " + ra + ", " + rb;
+        case Instruction::OP_SUB:
+            return "SUB " + r + ", " + ra + ", " + rb;
+        case Instruction::OP_MUL:
+            return "MUL " + r + ", " + ra + ", " + rb;
+        case Instruction::OP_DIV:
+            return "DIV " + r + ", " + ra + ", " + rb;
+        case Instruction::OP_POW:
+            return "POW " + r + ", " + ra + ", " + rb;
+        case Instruction::OP_MOD:
+            return "MOD " + r + ", " + ra + ", " + rb;
+        case Instruction::OP_ADDK:
+            return "ADDK " + r + ", " + ra + ", " + operand.toString();
+        case Instruction::OP_SUBK:
+            return "SUBK " + r + ", " + ra + ", " + operand.toString();
+        case Instruction::OP_MULK:
+            return "MULK " + r + ", " + ra + ", " + operand.toString();
+        case Instruction::OP_DIVK:
+            return "DIVK " + r + ", " + ra + ", " + operand.toString();
+        case Instruction::OP_POWK:
+            return "POWK " + r + ", " + ra + ", " + operand.toString();
+        case Instruction::OP_MODK:
+            return "MODK " + r + ", " + ra + ", " + operand.toString();
+        case Instruction::OP_KSUB:
+            return "KSUB " + r + ", " + operand.toString() + ", " + ra;
+        case Instruction::OP_KDIV:
+            return "KDIV " + r + ", " + operand.toString() + ", " + ra;
+        case Instruction::OP_MULADD:
+            return "MULADD " + r + ", " + ra + ", " + rb + ", r" + std::to_string(c);
+        case Instruction::OP_SINCOS:
+            return "SINCOS " + r + ", " + rb + ", " + ra;
+        case Instruction::OP_CALL1:
+        case Instruction::OP_CALL2:
+        case Instruction::OP_CALL3: {
+            std::string call = "CALL " + r + ", " + operand.toString() + "(";
+            int arity = operation - Instruction::OP_CALL1 + 1;
+            const int args[] = {a, b, c};
+            for(int i = 0; i < arity; ++i) {
+                call += (i == 0 ? "r" : ", r") + std::to_string(args[i]);
+            }
+            return call + ")";
+        }
+    }
+
+    return "UNKNOWN";
+}
@@ -1,50 +1,112 @@
 #pragma once
 #include <string>
-#include <stack>
+#include <cmath>
 
 class InstructionVM;
 
 class Operand {
     public:
+    Operand();
     Operand(int type, double value);
     Operand(int type, std::string name);
-    Operand(int type, char operatorSymbol);
+    Operand(int type, int functionId);
     std::string toString() const;
 
     enum Type {
-        TYPE_NUMBER = 0,
+        TYPE_NONE = 0,
+        TYPE_NUMBER,
         TYPE_VARIABLE,
-        TYPE_FUNCTION,
-        TYPE_OPERATOR
+        TYPE_FUNCTION
     };
 
-    double getValue(InstructionVM* vm) const;
+    int getType() const;
     std::string getName() const;
-    char getOperatorSymbol() const;
+
+    // Read on every executed instruction, kept inline
+    double getValue() const {
+        return value;
+    }
+    int getFunctionId() const {
+        return functionId;
+    }
 
     private:
     int type;
     double value;
     std::string name;
-    char operatorSymbol;
+    int functionId;
 };
 
+// Three-address register instruction, registers are assigned by Calculator::compileAst.
+// Register sources are always a prefix of a, b, c.
 class Instruction {
     public:
-    Instruction(int operation, Operand operand);
-    void execute(std::stack<Operand>& stack, InstructionVM* vm);
-    void executeFunctionCall(std::stack<Operand>& stack, InstructionVM* vm);
-    void executeOperator(std::stack<Operand>& stack, InstructionVM* vm);
+    Instruction(int operation, int dst, int a = 0, int b = 0, int c = 0, Operand operand = Operand());
 
     std::string toString() const;
 
     enum Operation {
-        OP_PUSH = 0,
-        OP_OPERATOR,
-        OP_CALL
+        OP_LOAD_CONSTANT = 0,   // r[dst] = operand
+        OP_LOAD_VARIABLE,       // r[dst] = variables[a]
+        OP_STORE_VARIABLE,      // variables[b] = r[a], has no dst
+        OP_ADD,                 // r[dst] = r[a] + r[b]
+        OP_SUB,
+        OP_MUL,
+        OP_DIV,
+        OP_POW,
+        OP_MOD,
+        OP_CALL1,               // r[dst] = function operand(r[a])
+        OP_CALL2,               // r[dst] = function operand(r[a], r[b])
+        OP_CALL3,               // r[dst] = function operand(r[a], r[b], r[c])
+
+        // Produced by Optimizer::peephole, k is the operand value
+        OP_ADDK,                // r[dst] = r[a] + k
+        OP_SUBK,                // r[dst] = r[a] - k
+        OP_MULK,                // r[dst] = r[a] * k
+        OP_DIVK,                // r[dst] = r[a] / k
+        OP_POWK,                // r[dst] = r[a] ^ k
+        OP_MODK,                // r[dst] = r[a] % k
+        OP_KSUB,                // r[dst] = k - r[a]
+        OP_KDIV,                // r[dst] = k / r[a]
+        OP_MULADD,              // r[dst] = r[a] * r[b] + r[c]
+        OP_SINCOS,              // r[dst] = sin(r[a]), r[b] = cos(r[a])
+
+        OP_COUNT
     };
 
+    static int operationFromOperator(char symbol);
+    static bool isBinaryOperation(int operation);
+    static bool isImmediateOperation(int operation);
+    // Computes a binary operation exactly as the VM does
+    static double evaluate(int operation, double a, double b);
+
+    // a * b + c, fused when the target has hardware FMA, otherwise rounded like MUL then ADD
+    static double multiplyAdd(double a, double b, double c) {
+#ifdef FP_FAST_FMA
+        return std::fma(a, b, c);
+#else
+        return a * b + c;
+#endif
+    }
+
+    // Fill the registers read/written by this instruction, return how many there are
+    int getSources(int sources[3]) const;
+    int getDestinations(int destinations[2]) const;
+
+    int getOperation() const;
+    int getDst() const;
+    int getA() const;
+    int getB() const;
+    int getC() const;
+    const Operand& getOperand() const;
+
     private:
+    friend class InstructionVM;
+
     int operation;
+    int dst;
+    int a;
+    int b;
+    int c;
     Operand operand;
-};
\ No newline at end of file
+};
@@ -1,39 +1,182 @@
+#include <math.h>
+#include <algorithm>
+#include <functional>
+
 #include "InstructionVM.h"
 #include "Instruction.h"
+#include "Functions.h"
+#include "JitProgram.h"
+#include "Program.h"
 
 InstructionVM::InstructionVM() {
-    stack = new std::stack<Operand>();
 }
 
 InstructionVM::~InstructionVM() {
-    delete stack;
 }
 
 void InstructionVM::reset() {
+    std::fill(variables.begin(), variables.end(), 0.);
+    std::fill(registers.begin(), registers.end(), 0.);
+}
+
+InstructionVM::Slot InstructionVM::bind(std::string_view name) {
+    if((variables.size() + 1) * 2 > slotTable.size()) {
+        growSlotTable();
+    }
+    size_t mask = slotTable.size() - 1;
+    for(size_t i = std::hash<std::string_view>()(name) & mask;; i = (i + 1) & mask) {
+        Slot slot = slotTable[i];
+        if(slot < 0) {
+            slot = variables.size();
+            slotTable[i] = slot;
+            if(variableNames.size() <= slot) {
+                variableNames.emplace_back();
+            }
+            variableNames[slot].assign(name);
+            variables.push_back(0.);
+            return slot;
+        }
+        if(variableNames[slot] == name) {
+            return slot;
+        }
+    }
+}
+
+InstructionVM::Slot InstructionVM::find(std::string_view name) const {
+    if(slotTable.empty()) {
+        return -1;
+    }
+    size_t mask = slotTable.size() - 1;
+    for(size_t i = std::hash<std::string_view>()(name) & mask;; i = (i + 1) & mask) {
+        Slot slot = slotTable[i];
+        if(slot < 0 || variableNames[slot] == name) {
+            return slot;
+        }
+    }
+}
+
+void InstructionVM::growSlotTable() {
+    slotTable.assign(std::max<size_t>(16, slotTable.size() * 2), -1);
+    size_t mask = slotTable.size() - 1;
+    for(Slot slot = 0; slot < variables.size(); ++slot) {
+        size_t i = std::hash<std::string_view>()(variableNames[slot]) & mask;
+        while(slotTable[i] >= 0) {
+            i = (i + 1) & mask;
+        }
+        slotTable[i] = slot;
+    }
+}
+
+void InstructionVM::clearVariables() {
+    std::fill(slotTable.begin(), slotTable.end(), -1);
     variables.clear();
-    stack->empty();
-    setVar("x", 0.);
 }
 
-void InstructionVM::setVar(std::string name, double value) {
-    variables[name] = value;
+void InstructionVM::setVar(std::string_view name, double value) {
+    setVar(bind(name), value);
+}
+
+double InstructionVM::getVar(std::string_view name) const {
+    Slot slot = find(name);
+    if(slot < 0) {
+        return 0.;
+    }
+    return variables[slot];
 }
 
-double InstructionVM::getVar(std::string name) {
-    //TODO: is this wanted behaviour?
-    return variables[name]; //Note this will create any variable that doesn't exist with a value of 0
+std::span<const std::string> InstructionVM::getVariableNames() const {
+    return std::span<const std::string>(variableNames.data(), variables.size());
 }
 
-double InstructionVM::getResult() {
-    return stack->top().getValue(this);
+double InstructionVM::getRegister(int index) const {
+    return registers[index];
 }
 
-void InstructionVM::execute(std::vector<Instruction>& instructions) {
-    for(auto &i: instructions) {
-        i.execute(*stack, this);
+void InstructionVM::reserveRegisters(int registerCount) {
+    if(registers.size() < registerCount) {
+        registers.resize(registerCount);
     }
 }
 
-std::stack<Operand>* InstructionVM::getStack() {
-    return stack;
-}
\ No newline at end of file
+void InstructionVM::execute(const JitProgram& program) {
+    program.execute(registers.data(), variables.data());
+}
+
+void InstructionVM::execute(const std::vector<Instruction>& instructions) {
+    double* r = registers.data();
+    double* v = variables.data();
+    for(const auto &i : instructions) {
+        switch(i.operation) {
+            case Instruction::OP_LOAD_CONSTANT:
+                r[i.dst] = i.operand.getValue();
+                break;
+            case Instruction::OP_LOAD_VARIABLE:
+                r[i.dst] = v[i.a];
+                break;
+            case Instruction::OP_STORE_VARIABLE:
+                v[i.b] = r[i.a];
+                break;
+            case Instruction::OP_ADD:
+                r[i.dst] = r[i.a] + r[i.b];
+                break;
+            case Instruction::OP_SUB:
+                r[i.dst] = r[i.a] - r[i.b];
+                break;
+            case Instruction::OP_MUL:
+                r[i.dst] = r[i.a] * r[i.b];
+                break;
+            case Instruction::OP_DIV:
+                r[i.dst] = r[i.a] / r[i.b];
+                break;
+            case Instruction::OP_POW:
+                r[i.dst] = pow(r[i.a], r[i.b]);
+                break;
+            case Instruction::OP_MOD:
+                r[i.dst] = fmod(r[i.a], r[i.b]);
+                break;
+            case Instruction::OP_CALL1:
+                r[i.dst] = Functions::get(i.operand.getFunctionId()).f1(r[i.a]);
+                break;
+            case Instruction::OP_CALL2:
+                r[i.dst] = Functions::get(i.operand.getFunctionId()).f2(r[i.a], r[i.b]);
+                break;
+            case Instruction::OP_CALL3:
+                r[i.dst] = Functions::get(i.operand.getFunctionId()).f3(r[i.a], r[i.b], r[i.c]);
+                break;
+            case Instruction::OP_ADDK:
+                r[i.dst] = r[i.a] + i.operand.getValue();
+                break;
+            case Instruction::OP_SUBK:
+                r[i.dst] = r[i.a] - i.operand.getValue();
+                break;
+            case Instruction::OP_MULK:
+                r[i.dst] = r[i.a] * i.operand.getValue();
+                break;
+            case Instruction::OP_DIVK:
+                r[i.dst] = r[i.a] / i.operand.getValue();
+                break;
+            case Instruction::OP_POWK:
+                r[i.dst] = pow(r[i.a], i.operand.getValue());
+                break;
+            case Instruction::OP_MODK:
+                r[i.dst] = fmod(r[i.a], i.operand.getValue());
+                break;
+            case Instruction::OP_KSUB:
+                r[i.dst] = i.operand.getValue() - r[i.a];
+                break;
+            case Instruction::OP_KDIV:
+                r[i.dst] = i.operand.getValue() / r[i.a];
+                break;
+            case Instruction::OP_MULADD:
+                r[i.dst] = Instruction::multiplyAdd(r[i.a], r[i.b], r[i.c]);
+                break;
+            case Instruction::OP_SINCOS:
+                Functions::sinCos(r[i.a], r[i.dst], r[i.b]);
+                break;
+        }
+    }
+}
+
+void InstructionVM::execute(const Program& program) {
+    program.execute(registers.data(), variables.data());
+}
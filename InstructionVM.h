@@ -1,26 +1,63 @@
 #pragma once
 #include <vector>
-#include <stack>
-#include <map>
+#include <string>
+#include <string_view>
+#include <span>
 
 class Instruction;
-class Operand;
+class JitProgram;
+class Program;
 class InstructionVM {
     public:
+    // Index of a variable in the VM's variable array, valid until clearVariables
+    typedef int Slot;
+
     InstructionVM();
     ~InstructionVM();
     
-    void execute(std::vector<Instruction>& instructions);
-    std::stack<Operand>* getStack();
+    // Sizes the register file for a verified program, done once when it is compiled so
+    // execution never allocates or checks bounds
+    void reserveRegisters(int registerCount);
+
+    // Reference interpreter, one switch per instruction
+    void execute(const std::vector<Instruction>& instructions);
+    // Dispatches with computed gotos where the compiler supports them
+    void execute(const Program& program);
+    // Runs native code compiled from the same instructions against this VM's registers and variables
+    void execute(const JitProgram& program);
+    double getRegister(int index) const;
+
+    // Returns the slot for name, assigning a new one if the name hasn't been seen before
+    Slot bind(std::string_view name);
+    // Forgets every name and value, so the table only ever holds the names of one
+    // compilation rather than every prefix typed. Keeps its buffers, rebinding the same
+    // names doesn't allocate
+    void clearVariables();
 
-    void setVar(std::string name, double value);
-    double getVar(std::string name);
+    void setVar(Slot slot, double value) {
+        variables[slot] = value;
+    }
+    double getVar(Slot slot) const {
+        return variables[slot];
+    }
 
-    double getResult();
+    void setVar(std::string_view name, double value);
+    double getVar(std::string_view name) const;
+
+    // Indexed by slot
+    std::span<const std::string> getVariableNames() const;
 
     void reset();
 
     private:
-    std::map<std::string, double> variables;
-    std::stack<Operand>* stack;
-};
\ No newline at end of file
+    // Slot of name, or -1
+    Slot find(std::string_view name) const;
+    void growSlotTable();
+
+    // Open addressing from the hash of a name to its slot, -1 where empty. Kept at most half full
+    std::vector<Slot> slotTable;
+    // The first variables.size() are bound, the rest keep their buffers for reuse
+    std::vector<std::string> variableNames;
+    std::vector<double> variables;
+    std::vector<double> registers;
+};
@@ -0,0 +1,447 @@
+#include "Interval.h"
+#include "Builtins.h"
+
+#include <math.h>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace {
+    const double infinity = std::numeric_limits<double>::infinity();
+
+    // IEEE operations round correctly, so one step outward covers the rounding of a bound
+    // as well as that of any scalar result between the bounds
+    double down(double x) {
+        return nextafter(x, -infinity);
+    }
+    double up(double x) {
+        return nextafter(x, infinity);
+    }
+
+    // libm is only accurate to a few ulps, both at the bounds and at the scalar results
+    // they must hold, so its bounds step out twice its error and then some
+    const int libmUlps = 8;
+    double downLibm(double x) {
+        for(int i = 0; i < libmUlps; ++i) {
+            x = down(x);
+        }
+        return x;
+    }
+    double upLibm(double x) {
+        for(int i = 0; i < libmUlps; ++i) {
+            x = up(x);
+        }
+        return x;
+    }
+
+    // A NaN bound comes from inf - inf or inf / inf at the bounds, that side is unbounded
+    Interval bounded(double lo, double hi, bool continuous) {
+        return {lo == lo ? lo : -infinity, hi == hi ? hi : infinity, continuous};
+    }
+
+    // Smallest interval holding the results at the corners of a box, for operations that
+    // are monotonic in each argument
+    Interval hull(const double* corners, int count, bool continuous, bool libm) {
+        double lo = infinity;
+        double hi = -infinity;
+        for(int i = 0; i < count; ++i) {
+            if(corners[i] != corners[i]) {
+                return {-infinity, infinity, continuous};
+            }
+            lo = std::min(lo, corners[i]);
+            hi = std::max(hi, corners[i]);
+        }
+        return libm ? Interval{downLibm(lo), upLibm(hi), continuous} : Interval{down(lo), up(hi), continuous};
+    }
+
+    Interval increasing(Interval a, double (*f)(double)) {
+        if(a.isEmpty()) {
+            return Interval::empty();
+        }
+        return bounded(downLibm(f(a.lo)), upLibm(f(a.hi)), a.continuous);
+    }
+
+    Interval decreasing(Interval a, double (*f)(double)) {
+        if(a.isEmpty()) {
+            return Interval::empty();
+        }
+        return bounded(downLibm(f(a.hi)), upLibm(f(a.lo)), a.continuous);
+    }
+
+    // The part of a within a function's domain, no longer continuous if any of a was outside
+    Interval restrict(Interval a, double lo, double hi) {
+        if(a.isEmpty() || a.hi < lo || a.lo > hi) {
+            return Interval::empty();
+        }
+        return {std::max(a.lo, lo), std::min(a.hi, hi), a.continuous && a.lo >= lo && a.hi <= hi};
+    }
+
+    // Narrows a result to its function's range, which outward rounding may have crossed
+    Interval within(Interval a, double lo, double hi) {
+        return {std::max(a.lo, lo), std::min(a.hi, hi), a.continuous};
+    }
+
+    // Arguments of sin, cos and tan beyond this are left unbounded, below it the rounding
+    // error in placing their turning points is far smaller than the slack allowed for it
+    const double largeAngle = 1048576.;
+
+    // Whether [lo, hi] might hold offset + k * period for some integer k, erring towards yes
+    bool mayContain(double lo, double hi, double offset, double period) {
+        if(hi - lo >= period) {
+            return true;
+        }
+        const double slack = 1e-9;
+        return ::floor((hi - offset) / period + slack) >= ::ceil((lo - offset) / period - slack);
+    }
+
+    // An infinite times zero at a corner stands for products of any size, which the other
+    // corners already reach from zero
+    double product(double a, double b) {
+        double p = a * b;
+        return p == p ? p : 0.;
+    }
+}
+
+Interval Interval::entire() {
+    return {-infinity, infinity, true};
+}
+
+Interval Interval::empty() {
+    return {NAN, NAN, false};
+}
+
+Interval IntervalBuiltins::add(Interval a, Interval b) {
+    if(a.isEmpty() || b.isEmpty()) {
+        return Interval::empty();
+    }
+    return bounded(down(a.lo + b.lo), up(a.hi + b.hi), a.continuous && b.continuous);
+}
+
+Interval IntervalBuiltins::sub(Interval a, Interval b) {
+    if(a.isEmpty() || b.isEmpty()) {
+        return Interval::empty();
+    }
+    return bounded(down(a.lo - b.hi), up(a.hi - b.lo), a.continuous && b.continuous);
+}
+
+Interval IntervalBuiltins::mul(Interval a, Interval b) {
+    if(a.isEmpty() || b.isEmpty()) {
+        return Interval::empty();
+    }
+    double corners[] = {product(a.lo, b.lo), product(a.lo, b.hi), product(a.hi, b.lo), product(a.hi, b.hi)};
+    return hull(corners, 4, a.continuous && b.continuous, false);
+}
+
+Interval IntervalBuiltins::div(Interval a, Interval b) {
+    if(a.isEmpty() || b.isEmpty()) {
+        return Interval::empty();
+    }
+    if(b.lo <= 0. && b.hi >= 0.) {
+        // A pole, unless a is zero which leaves zero and 0 / 0
+        if(a.lo == 0. && a.hi == 0.) {
+            return {0., 0., false};
+        }
+        return {-infinity, infinity, false};
+    }
+    double corners[] = {a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi};
+    return hull(corners, 4, a.continuous && b.continuous, false);
+}
+
+Interval IntervalBuiltins::mod(Interval a, Interval b) {
+    if(a.isEmpty() || b.isEmpty()) {
+        return Interval::empty();
+    }
+    // fmod is exact, takes the sign of a and is smaller than both a and b
+    double magnitude = std::max(std::fabs(b.lo), std::fabs(b.hi));
+    if(magnitude == 0.) {
+        return Interval::empty();
+    }
+    if(b.lo == b.hi && a.hi - a.lo < magnitude) {
+        // Between multiples of b it rises with a, passing one makes it fall back
+        double lo = fmod(a.lo, magnitude);
+        double hi = fmod(a.hi, magnitude);
+        if(lo <= hi) {
+            return {lo, hi, a.continuous && b.continuous};
+        }
+    }
+    return {a.lo >= 0. ? 0. : std::max(-magnitude, a.lo), a.hi <= 0. ? 0. : std::min(magnitude, a.hi), false};
+}
+
+Interval IntervalBuiltins::pow(Interval a, Interval b) {
+    if(a.isEmpty() || b.isEmpty()) {
+        return Interval::empty();
+    }
+    bool continuous = a.continuous && b.continuous;
+
+    // Integer powers, the common case, are defined for negative bases too
+    double n = b.lo;
+    if(b.lo == b.hi && std::fabs(n) < 9007199254740992. && n == ::round(n)) {
+        if(n == 0.) {
+            return {1., 1., continuous};
+        }
+        bool odd = ::fmod(n, 2.) != 0.;
+        bool spansZero = a.lo <= 0. && a.hi >= 0.;
+        if(n < 0. && spansZero) {
+            return {odd ? -infinity : 0., infinity, false};
+        }
+        if(odd) {
+            return n > 0. ? bounded(downLibm(::pow(a.lo, n)), upLibm(::pow(a.hi, n)), continuous)
+                : bounded(downLibm(::pow(a.hi, n)), upLibm(::pow(a.lo, n)), continuous);
+        }
+        // Even powers only see the magnitude
+        double smallest = spansZero ? 0. : std::min(std::fabs(a.lo), std::fabs(a.hi));
+        double largest = std::max(std::fabs(a.lo), std::fabs(a.hi));
+        Interval result = n > 0. ? bounded(downLibm(::pow(smallest, n)), upLibm(::pow(largest, n)), continuous)
+            : bounded(downLibm(::pow(largest, n)), upLibm(::pow(smallest, n)), continuous);
+        return within(result, 0., infinity);
+    }
+
+    // Otherwise the power is monotonic in each argument over a box of non-negative bases,
+    // so its extremes are at the corners
+    if(a.lo < 0.) {
+        // Negative bases only have integer powers, which are no larger in magnitude than
+        // those of the largest base
+        double largest = std::max(std::fabs(a.lo), std::fabs(a.hi));
+        double corners[] = {::pow(0., b.lo), ::pow(0., b.hi), ::pow(largest, b.lo), ::pow(largest, b.hi)};
+        Interval magnitude = hull(corners, 4, false, true);
+        return {-magnitude.hi, magnitude.hi, false};
+    }
+    double corners[] = {::pow(a.lo, b.lo), ::pow(a.lo, b.hi), ::pow(a.hi, b.lo), ::pow(a.hi, b.hi)};
+    // 0 to a power at or below zero is a pole or 0^0
+    return within(hull(corners, 4, continuous && !(a.lo == 0. && b.lo <= 0.), true), 0., infinity);
+}
+
+Interval IntervalBuiltins::multiplyAdd(Interval a, Interval b, Interval c) {
+    // Holds both the fused and the separately rounded result
+    return add(mul(a, b), c);
+}
+
+Interval IntervalBuiltins::max(Interval a, Interval b) {
+    if(a.isEmpty() || b.isEmpty()) {
+        return Interval::empty();
+    }
+    return {std::max(a.lo, b.lo), std::max(a.hi, b.hi), a.continuous && b.continuous};
+}
+
+Interval IntervalBuiltins::min(Interval a, Interval b) {
+    if(a.isEmpty() || b.isEmpty()) {
+        return Interval::empty();
+    }
+    return {std::min(a.lo, b.lo), std::min(a.hi, b.hi), a.continuous && b.continuous};
+}
+
+Interval IntervalBuiltins::saturate(Interval a) {
+    return max(Interval::point(0.), min(Interval::point(1.), a));
+}
+
+Interval IntervalBuiltins::clamp(Interval a, Interval b, Interval c) {
+    return max(b, min(c, a));
+}
+
+Interval IntervalBuiltins::sin(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    if(!(std::fabs(a.lo) < largeAngle && std::fabs(a.hi) < largeAngle)) {
+        return {-1., 1., a.continuous && std::isfinite(a.lo) && std::isfinite(a.hi)};
+    }
+    double first = Builtins::sin(a.lo);
+    double last = Builtins::sin(a.hi);
+    double lo = mayContain(a.lo, a.hi, -M_PI / 2., 2. * M_PI) ? -1. : downLibm(std::min(first, last));
+    double hi = mayContain(a.lo, a.hi, M_PI / 2., 2. * M_PI) ? 1. : upLibm(std::max(first, last));
+    return within({lo, hi, a.continuous}, -1., 1.);
+}
+
+Interval IntervalBuiltins::cos(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    if(!(std::fabs(a.lo) < largeAngle && std::fabs(a.hi) < largeAngle)) {
+        return {-1., 1., a.continuous && std::isfinite(a.lo) && std::isfinite(a.hi)};
+    }
+    double first = Builtins::cos(a.lo);
+    double last = Builtins::cos(a.hi);
+    double lo = mayContain(a.lo, a.hi, M_PI, 2. * M_PI) ? -1. : downLibm(std::min(first, last));
+    double hi = mayContain(a.lo, a.hi, 0., 2. * M_PI) ? 1. : upLibm(std::max(first, last));
+    return within({lo, hi, a.continuous}, -1., 1.);
+}
+
+Interval IntervalBuiltins::tan(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    // Rising on each branch, so over less than a period a pole shows as the value at the
+    // end falling below the value at the start
+    if(std::fabs(a.lo) < largeAngle && std::fabs(a.hi) < largeAngle && a.hi - a.lo < 3.) {
+        double first = Builtins::tan(a.lo);
+        double last = Builtins::tan(a.hi);
+        if(first <= last) {
+            return {downLibm(first), upLibm(last), a.continuous};
+        }
+    }
+    return {-infinity, infinity, false};
+}
+
+Interval IntervalBuiltins::asin(Interval a) {
+    return increasing(restrict(a, -1., 1.), Builtins::asin);
+}
+
+Interval IntervalBuiltins::acos(Interval a) {
+    return decreasing(restrict(a, -1., 1.), Builtins::acos);
+}
+
+Interval IntervalBuiltins::atan(Interval a) {
+    return increasing(a, Builtins::atan);
+}
+
+Interval IntervalBuiltins::atan2(Interval a, Interval b) {
+    if(a.isEmpty() || b.isEmpty()) {
+        return Interval::empty();
+    }
+    // Within a half plane clear of the cut along negative x, atan2 is monotonic in each
+    // argument, so its extremes are at the corners
+    if(b.lo > 0. || a.lo > 0. || a.hi < 0.) {
+        double corners[] = {Builtins::atan2(a.lo, b.lo), Builtins::atan2(a.lo, b.hi), Builtins::atan2(a.hi, b.lo), Builtins::atan2(a.hi, b.hi)};
+        return hull(corners, 4, a.continuous && b.continuous, true);
+    }
+    return {downLibm(-M_PI), upLibm(M_PI), false};
+}
+
+Interval IntervalBuiltins::cosh(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    if(a.lo >= 0.) {
+        return within(increasing(a, Builtins::cosh), 1., infinity);
+    }
+    if(a.hi <= 0.) {
+        return within(decreasing(a, Builtins::cosh), 1., infinity);
+    }
+    return {1., upLibm(std::max(Builtins::cosh(a.lo), Builtins::cosh(a.hi))), a.continuous};
+}
+
+Interval IntervalBuiltins::tanh(Interval a) {
+    return within(increasing(a, Builtins::tanh), -1., 1.);
+}
+
+Interval IntervalBuiltins::asinh(Interval a) {
+    return increasing(a, Builtins::asinh);
+}
+
+Interval IntervalBuiltins::acosh(Interval a) {
+    return within(increasing(restrict(a, 1., infinity), Builtins::acosh), 0., infinity);
+}
+
+Interval IntervalBuiltins::atanh(Interval a) {
+    return increasing(restrict(a, -1., 1.), Builtins::atanh);
+}
+
+Interval IntervalBuiltins::sqrt(Interval a) {
+    a = restrict(a, 0., infinity);
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    return within({down(Builtins::sqrt(a.lo)), up(Builtins::sqrt(a.hi)), a.continuous}, 0., infinity);
+}
+
+Interval IntervalBuiltins::cbrt(Interval a) {
+    return increasing(a, Builtins::cbrt);
+}
+
+Interval IntervalBuiltins::rsqrt(Interval a) {
+    a = restrict(a, 0., infinity);
+    if(a.lo == 0.) {
+        // A pole, and zero may be -0 whose reciprocal is -inf
+        return {-infinity, infinity, false};
+    }
+    return within(decreasing(a, Builtins::rsqrt), 0., infinity);
+}
+
+Interval IntervalBuiltins::abs(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    if(a.lo >= 0.) {
+        return a;
+    }
+    if(a.hi <= 0.) {
+        return {-a.hi, -a.lo, a.continuous};
+    }
+    return {0., std::max(-a.lo, a.hi), a.continuous};
+}
+
+Interval IntervalBuiltins::sign(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    if(a.lo > 0.) {
+        return {1., 1., a.continuous};
+    }
+    if(a.hi < 0.) {
+        return {-1., -1., a.continuous};
+    }
+    // Zero is either sign
+    return {-1., 1., false};
+}
+
+Interval IntervalBuiltins::exp(Interval a) {
+    return within(increasing(a, Builtins::exp), 0., infinity);
+}
+
+Interval IntervalBuiltins::exp2(Interval a) {
+    return within(increasing(a, Builtins::exp2), 0., infinity);
+}
+
+Interval IntervalBuiltins::exp10(Interval a) {
+    return within(increasing(a, Builtins::exp10), 0., infinity);
+}
+
+Interval IntervalBuiltins::log(Interval a) {
+    return increasing(restrict(a, 0., infinity), Builtins::log);
+}
+
+Interval IntervalBuiltins::log2(Interval a) {
+    return increasing(restrict(a, 0., infinity), Builtins::log2);
+}
+
+Interval IntervalBuiltins::log10(Interval a) {
+    return increasing(restrict(a, 0., infinity), Builtins::log10);
+}
+
+// Rounding to integers is exact and never falls, a step shows as the ends differing
+Interval IntervalBuiltins::ceil(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    double lo = Builtins::ceil(a.lo);
+    double hi = Builtins::ceil(a.hi);
+    return {lo, hi, a.continuous && lo == hi};
+}
+
+Interval IntervalBuiltins::floor(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    double lo = Builtins::floor(a.lo);
+    double hi = Builtins::floor(a.hi);
+    return {lo, hi, a.continuous && lo == hi};
+}
+
+Interval IntervalBuiltins::round(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    double lo = Builtins::round(a.lo);
+    double hi = Builtins::round(a.hi);
+    return {lo, hi, a.continuous && lo == hi};
+}
+
+Interval IntervalBuiltins::fract(Interval a) {
+    if(a.isEmpty()) {
+        return Interval::empty();
+    }
+    if(std::isfinite(a.lo) && std::isfinite(a.hi) && ::floor(a.lo) == ::floor(a.hi)) {
+        return within({down(Builtins::fract(a.lo)), up(Builtins::fract(a.hi)), a.continuous}, 0., 1.);
+    }
+    return {0., 1., false};
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// A closed range of doubles, for evaluating a program over every value of its variables
+// in a range at once. Bounds are rounded outward, so an interval holds every value other
+// than NaN that the scalar VM can produce for operands within the operand intervals,
+// including the infinities. An interval with NaN bounds is empty, no value is defined.
+//
+// continuous is cleared once any operation meets a jump, a pole or the edge of its domain
+// within its operands, so a continuous result bounds a curve without breaks.
+struct Interval {
+    double lo;
+    double hi;
+    bool continuous;
+
+    static Interval point(double value) {
+        return {value, value, true};
+    }
+    static Interval range(double lo, double hi) {
+        return {lo, hi, true};
+    }
+    static Interval entire();
+    static Interval empty();
+
+    bool isEmpty() const {
+        return !(lo <= hi);
+    }
+    bool contains(double value) const {
+        return lo <= value && value <= hi;
+    }
+};
+
+// Interval versions of the operators and of every builtin in Builtins
+class IntervalBuiltins {
+    public:
+    static Interval add(Interval a, Interval b);
+    static Interval sub(Interval a, Interval b);
+    static Interval mul(Interval a, Interval b);
+    static Interval div(Interval a, Interval b);
+    static Interval mod(Interval a, Interval b);
+    static Interval pow(Interval a, Interval b);
+    static Interval multiplyAdd(Interval a, Interval b, Interval c);
+
+    static Interval max(Interval a, Interval b);
+    static Interval min(Interval a, Interval b);
+    static Interval saturate(Interval a);
+    static Interval clamp(Interval a, Interval b, Interval c);
+    static Interval sin(Interval a);
+    static Interval cos(Interval a);
+    static Interval tan(Interval a);
+    static Interval asin(Interval a);
+    static Interval acos(Interval a);
+    static Interval atan(Interval a);
+    static Interval atan2(Interval a, Interval b);
+    static Interval cosh(Interval a);
+    static Interval tanh(Interval a);
+    static Interval asinh(Interval a);
+    static Interval acosh(Interval a);
+    static Interval atanh(Interval a);
+    static Interval sqrt(Interval a);
+    static Interval cbrt(Interval a);
+    static Interval rsqrt(Interval a);
+    static Interval abs(Interval a);
+    static Interval sign(Interval a);
+    static Interval exp(Interval a);
+    static Interval exp2(Interval a);
+    static Interval exp10(Interval a);
+    static Interval log(Interval a);
+    static Interval log2(Interval a);
+    static Interval log10(Interval a);
+    static Interval ceil(Interval a);
+    static Interval floor(Interval a);
+    static Interval round(Interval a);
+    static Interval fract(Interval a);
+};
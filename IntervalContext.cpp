@@ -0,0 +1,89 @@
+#include "IntervalContext.h"
+#include "Program.h"
+
+void IntervalContext::prepare(const Program& program) {
+    registers.assign(program.getRegisterCount(), Interval::point(0.));
+    variables.assign(program.getVariableCount(), Interval::point(0.));
+}
+
+Interval IntervalContext::execute(const Program& program) {
+    Interval* r = registers.data();
+    Interval* v = variables.data();
+    const double* k = program.getConstants();
+    typedef IntervalBuiltins B;
+    Interval unknown = Interval::entire();
+    unknown.continuous = false;
+
+    // Interval operations cost far more than dispatch, so a plain switch is enough
+    for(const Program::Step* s = program.getSteps(); ; ++s) {
+        switch(s->opcode) {
+            case Program::OP_LOAD_CONSTANT: r[s->dst] = Interval::point(k[s->a]); break;
+            case Program::OP_LOAD_VARIABLE: r[s->dst] = v[s->a]; break;
+            case Program::OP_STORE_VARIABLE: v[s->b] = r[s->a]; break;
+            case Program::OP_ADD: r[s->dst] = B::add(r[s->a], r[s->b]); break;
+            case Program::OP_SUB: r[s->dst] = B::sub(r[s->a], r[s->b]); break;
+            case Program::OP_MUL:
+                // A register times itself is a square, which unlike a product of two
+                // independent intervals is never negative
+                r[s->dst] = s->a == s->b ? B::pow(r[s->a], Interval::point(2.)) : B::mul(r[s->a], r[s->b]);
+                break;
+            case Program::OP_DIV: r[s->dst] = B::div(r[s->a], r[s->b]); break;
+            case Program::OP_POW: r[s->dst] = B::pow(r[s->a], r[s->b]); break;
+            case Program::OP_MOD: r[s->dst] = B::mod(r[s->a], r[s->b]); break;
+            // Every builtin has an opcode, a call could be to anything
+            case Program::OP_CALL1: r[s->dst] = unknown; break;
+            case Program::OP_CALL2:
+            case Program::OP_CALL3: r[s->dst] = unknown; ++s; break;
+            case Program::OP_ADDK: r[s->dst] = B::add(r[s->a], Interval::point(k[s->b])); break;
+            case Program::OP_SUBK: r[s->dst] = B::sub(r[s->a], Interval::point(k[s->b])); break;
+            case Program::OP_MULK: r[s->dst] = B::mul(r[s->a], Interval::point(k[s->b])); break;
+            case Program::OP_DIVK: r[s->dst] = B::div(r[s->a], Interval::point(k[s->b])); break;
+            case Program::OP_POWK: r[s->dst] = B::pow(r[s->a], Interval::point(k[s->b])); break;
+            case Program::OP_MODK: r[s->dst] = B::mod(r[s->a], Interval::point(k[s->b])); break;
+            case Program::OP_KSUB: r[s->dst] = B::sub(Interval::point(k[s->b]), r[s->a]); break;
+            case Program::OP_KDIV: r[s->dst] = B::div(Interval::point(k[s->b]), r[s->a]); break;
+            case Program::OP_MULADD: r[s->dst] = B::multiplyAdd(r[s->a], r[s->b], r[s[1].a]); ++s; break;
+            case Program::OP_SINCOS: {
+                // dst and b may be the source
+                Interval a = r[s->a];
+                r[s->dst] = B::sin(a);
+                r[s->b] = B::cos(a);
+                break;
+            }
+            case Program::OP_MAX: r[s->dst] = B::max(r[s->a], r[s->b]); break;
+            case Program::OP_MIN: r[s->dst] = B::min(r[s->a], r[s->b]); break;
+            case Program::OP_SATURATE: r[s->dst] = B::saturate(r[s->a]); break;
+            case Program::OP_CLAMP: r[s->dst] = B::clamp(r[s->a], r[s->b], r[s[1].a]); ++s; break;
+            case Program::OP_SIN: r[s->dst] = B::sin(r[s->a]); break;
+            case Program::OP_COS: r[s->dst] = B::cos(r[s->a]); break;
+            case Program::OP_TAN: r[s->dst] = B::tan(r[s->a]); break;
+            case Program::OP_ASIN: r[s->dst] = B::asin(r[s->a]); break;
+            case Program::OP_ACOS: r[s->dst] = B::acos(r[s->a]); break;
+            case Program::OP_ATAN: r[s->dst] = B::atan(r[s->a]); break;
+            case Program::OP_ATAN2: r[s->dst] = B::atan2(r[s->a], r[s->b]); break;
+            case Program::OP_COSH: r[s->dst] = B::cosh(r[s->a]); break;
+            case Program::OP_TANH: r[s->dst] = B::tanh(r[s->a]); break;
+            case Program::OP_ASINH: r[s->dst] = B::asinh(r[s->a]); break;
+            case Program::OP_ACOSH: r[s->dst] = B::acosh(r[s->a]); break;
+            case Program::OP_ATANH: r[s->dst] = B::atanh(r[s->a]); break;
+            case Program::OP_SQRT: r[s->dst] = B::sqrt(r[s->a]); break;
+            case Program::OP_CBRT: r[s->dst] = B::cbrt(r[s->a]); break;
+            case Program::OP_RSQRT: r[s->dst] = B::rsqrt(r[s->a]); break;
+            case Program::OP_ABS: r[s->dst] = B::abs(r[s->a]); break;
+            case Program::OP_SIGN: r[s->dst] = B::sign(r[s->a]); break;
+            case Program::OP_EXP: r[s->dst] = B::exp(r[s->a]); break;
+            case Program::OP_EXP2: r[s->dst] = B::exp2(r[s->a]); break;
+            case Program::OP_EXP10: r[s->dst] = B::exp10(r[s->a]); break;
+            case Program::OP_LOG: r[s->dst] = B::log(r[s->a]); break;
+            case Program::OP_LOG2: r[s->dst] = B::log2(r[s->a]); break;
+            case Program::OP_LOG10: r[s->dst] = B::log10(r[s->a]); break;
+            case Program::OP_CEIL: r[s->dst] = B::ceil(r[s->a]); break;
+            case Program::OP_FLOOR: r[s->dst] = B::floor(r[s->a]); break;
+            case Program::OP_ROUND: r[s->dst] = B::round(r[s->a]); break;
+            case Program::OP_FRACT: r[s->dst] = B::fract(r[s->a]); break;
+            case Program::OP_END:
+                // An empty program has no result register
+                return program.getResultRegister() < 0 ? Interval::empty() : r[program.getResultRegister()];
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+
+#include "Interval.h"
+
+class Program;
+
+// Evaluates a program over intervals instead of numbers: every variable is a range and the
+// result bounds every value the scalar VM gives for variables within those ranges. Runs the
+// same compiled program as ExecutionContext, and like it holds only the mutable state of an
+// evaluation, so each thread uses a context of its own.
+class IntervalContext {
+    public:
+    // Sizes the storage for program and sets the variables to zero
+    void prepare(const Program& program);
+
+    // Slots come from Program::findSlot, program must have been prepared
+    void setVar(int slot, Interval value) {
+        variables[slot] = value;
+    }
+
+    // Runs a prepared program and returns the interval holding its result
+    Interval execute(const Program& program);
+
+    private:
+    std::vector<Interval> registers;
+    std::vector<Interval> variables;
+};
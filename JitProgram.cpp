@@ -0,0 +1,286 @@
+#include "JitProgram.h"
+#include "Instruction.h"
+#include "Functions.h"
+
+#include <math.h>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define ADVANCEDCALC_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef ADVANCEDCALC_JIT
+namespace {
+    // Machine code emitter for the handful of SSE2 forms the translation needs.
+    // rbx holds the register file and rbp the variables, both callee saved so they
+    // survive calls into libm.
+    class Emitter {
+        public:
+        enum Base {
+            BASE_REGISTERS = 3, // rbx
+            BASE_VARIABLES = 5  // rbp
+        };
+
+        enum ScalarOp {
+            SSE_LOAD = 0x10,
+            SSE_STORE = 0x11,
+            SSE_SQRT = 0x51,
+            SSE_ADD = 0x58,
+            SSE_MUL = 0x59,
+            SSE_SUB = 0x5C,
+            SSE_DIV = 0x5E
+        };
+
+        std::vector<uint8_t> code;
+
+        void byte(uint8_t b) {
+            code.push_back(b);
+        }
+
+        void int32(int32_t v) {
+            for(int i = 0; i < 4; ++i) byte((v >> (i * 8)) & 0xFF);
+        }
+
+        void int64(uint64_t v) {
+            for(int i = 0; i < 8; ++i) byte((v >> (i * 8)) & 0xFF);
+        }
+
+        // op xmm, [base + 8 * index] (or the store form)
+        void scalar(ScalarOp op, int xmm, Base base, int index) {
+            byte(0xF2);
+            byte(0x0F);
+            byte(op);
+            byte(0x80 | (xmm << 3) | base);
+            int32(index * 8);
+        }
+
+        // op xmm, xmmSource
+        void scalarRegister(ScalarOp op, int xmm, int xmmSource) {
+            byte(0xF2);
+            byte(0x0F);
+            byte(op);
+            byte(0xC0 | (xmm << 3) | xmmSource);
+        }
+
+        // xmm = constant, through rax
+        void loadConstant(int xmm, double value) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            byte(0x48); byte(0xB8); int64(bits);            // mov rax, imm64
+            byte(0x66); byte(0x48); byte(0x0F); byte(0x6E); // movq xmm, rax
+            byte(0xC0 | (xmm << 3));
+        }
+
+        // rdi/rsi = rbx + 8 * index, for passing register addresses
+        void leaArgument(int argument, int index) {
+            static const int argumentRegisters[] = {7, 6}; // rdi, rsi
+            byte(0x48); byte(0x8D);
+            byte(0x80 | (argumentRegisters[argument] << 3) | BASE_REGISTERS);
+            int32(index * 8);
+        }
+
+        void call(const void* function) {
+            byte(0x48); byte(0xB8); int64((uint64_t)(uintptr_t)function); // mov rax, imm64
+            byte(0xFF); byte(0xD0);                                        // call rax
+        }
+
+        void prologue() {
+            byte(0x53);                                     // push rbx
+            byte(0x55);                                     // push rbp
+            byte(0x48); byte(0x83); byte(0xEC); byte(0x08); // sub rsp, 8 (keeps calls 16 byte aligned)
+            byte(0x48); byte(0x89); byte(0xFB);             // mov rbx, rdi
+            byte(0x48); byte(0x89); byte(0xF5);             // mov rbp, rsi
+        }
+
+        void epilogue() {
+            byte(0x48); byte(0x83); byte(0xC4); byte(0x08); // add rsp, 8
+            byte(0x5D);                                     // pop rbp
+            byte(0x5B);                                     // pop rbx
+            byte(0xC3);                                     // ret
+        }
+    };
+
+    typedef double (*Binary_t)(double, double);
+    typedef void (*SinCos_t)(double, double&, double&);
+}
+#endif
+
+bool JitProgram::isSupported() {
+#ifdef ADVANCEDCALC_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::unique_ptr<JitProgram> JitProgram::compile(const std::vector<Instruction>& instructions, int registerCount, int resultRegister) {
+#ifdef ADVANCEDCALC_JIT
+    if(resultRegister < 0 || resultRegister >= registerCount) {
+        return nullptr;
+    }
+    // Native code indexes the register file unchecked. Every read is of a register written
+    // earlier, so destinations within registerCount keep every access in bounds
+    for(const auto &i : instructions) {
+        if(i.getDst() >= registerCount) {
+            return nullptr;
+        }
+    }
+
+    Emitter e;
+    e.prologue();
+
+    // Register whose value is still in xmm0 from the previous store, its reload can be skipped
+    int cached = -1;
+    auto load = [&](int xmm, int index) {
+        if(xmm != 0 || index != cached) {
+            e.scalar(Emitter::SSE_LOAD, xmm, Emitter::BASE_REGISTERS, index);
+        }
+    };
+
+    static const Binary_t powFunction = static_cast<Binary_t>(pow);
+    static const Binary_t fmodFunction = static_cast<Binary_t>(fmod);
+    static const SinCos_t sinCosFunction = &Functions::sinCos;
+    static const int sqrtId = Functions::find("sqrt");
+
+    for(const auto &i : instructions) {
+        int dst = i.getDst();
+        int a = i.getA();
+        int b = i.getB();
+        int c = i.getC();
+        double k = i.getOperand().getValue();
+
+        switch(i.getOperation()) {
+            case Instruction::OP_LOAD_CONSTANT:
+                e.loadConstant(0, k);
+                break;
+            case Instruction::OP_LOAD_VARIABLE:
+                e.scalar(Emitter::SSE_LOAD, 0, Emitter::BASE_VARIABLES, a);
+                break;
+            case Instruction::OP_STORE_VARIABLE:
+                load(0, a);
+                e.scalar(Emitter::SSE_STORE, 0, Emitter::BASE_VARIABLES, b);
+                cached = a;
+                continue;
+            case Instruction::OP_ADD:
+            case Instruction::OP_SUB:
+            case Instruction::OP_MUL:
+            case Instruction::OP_DIV: {
+                static const Emitter::ScalarOp ops[] = {Emitter::SSE_ADD, Emitter::SSE_SUB, Emitter::SSE_MUL, Emitter::SSE_DIV};
+                load(0, a);
+                e.scalar(ops[i.getOperation() - Instruction::OP_ADD], 0, Emitter::BASE_REGISTERS, b);
+                break;
+            }
+            case Instruction::OP_ADDK:
+            case Instruction::OP_SUBK:
+            case Instruction::OP_MULK:
+            case Instruction::OP_DIVK: {
+                static const Emitter::ScalarOp ops[] = {Emitter::SSE_ADD, Emitter::SSE_SUB, Emitter::SSE_MUL, Emitter::SSE_DIV};
+                e.loadConstant(1, k);
+                load(0, a);
+                e.scalarRegister(ops[i.getOperation() - Instruction::OP_ADDK], 0, 1);
+                break;
+            }
+            case Instruction::OP_KSUB:
+            case Instruction::OP_KDIV:
+                e.loadConstant(0, k);
+                e.scalar(i.getOperation() == Instruction::OP_KSUB ? Emitter::SSE_SUB : Emitter::SSE_DIV, 0, Emitter::BASE_REGISTERS, a);
+                break;
+            case Instruction::OP_POW:
+            case Instruction::OP_MOD:
+                load(0, a);
+                load(1, b);
+                e.call((const void*)(i.getOperation() == Instruction::OP_POW ? powFunction : fmodFunction));
+                break;
+            case Instruction::OP_POWK:
+            case Instruction::OP_MODK:
+                load(0, a);
+                e.loadConstant(1, k);
+                e.call((const void*)(i.getOperation() == Instruction::OP_POWK ? powFunction : fmodFunction));
+                break;
+            case Instruction::OP_MULADD:
+                load(0, a);
+                load(1, b);
+                load(2, c);
+#ifdef FP_FAST_FMA
+                e.call((const void*)&Instruction::multiplyAdd);
+#else
+                e.scalarRegister(Emitter::SSE_MUL, 0, 1);
+                e.scalarRegister(Emitter::SSE_ADD, 0, 2);
+#endif
+                break;
+            case Instruction::OP_CALL1: {
+                int functionId = i.getOperand().getFunctionId();
+                if(functionId == sqrtId) {
+                    load(0, a);
+                    e.scalarRegister(Emitter::SSE_SQRT, 0, 0);
+                    break;
+                }
+                load(0, a);
+                e.call((const void*)Functions::get(functionId).f1);
+                break;
+            }
+            case Instruction::OP_CALL2:
+                load(0, a);
+                load(1, b);
+                e.call((const void*)Functions::get(i.getOperand().getFunctionId()).f2);
+                break;
+            case Instruction::OP_CALL3:
+                load(0, a);
+                load(1, b);
+                load(2, c);
+                e.call((const void*)Functions::get(i.getOperand().getFunctionId()).f3);
+                break;
+            case Instruction::OP_SINCOS:
+                load(0, a);
+                e.leaArgument(0, dst);
+                e.leaArgument(1, b);
+                e.call((const void*)sinCosFunction);
+                cached = -1;
+                continue;
+            default:
+                return nullptr;
+        }
+
+        e.scalar(Emitter::SSE_STORE, 0, Emitter::BASE_REGISTERS, dst);
+        cached = dst;
+    }
+
+    load(0, resultRegister);
+    e.epilogue();
+
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t size = (e.code.size() + pageSize - 1) / pageSize * pageSize;
+    void* code = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(code == MAP_FAILED) {
+        return nullptr;
+    }
+    std::memcpy(code, e.code.data(), e.code.size());
+    if(mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, size);
+        return nullptr;
+    }
+
+    return std::unique_ptr<JitProgram>(new JitProgram(code, size));
+#else
+    (void)instructions;
+    (void)registerCount;
+    (void)resultRegister;
+    return nullptr;
+#endif
+}
+
+JitProgram::JitProgram(void* code, size_t size) :code(code), size(size), entry(reinterpret_cast<Entry_t>(code)) {
+}
+
+JitProgram::~JitProgram() {
+#ifdef ADVANCEDCALC_JIT
+    munmap(code, size);
+#endif
+}
+
+size_t JitProgram::getCodeSize() const {
+    return size;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+class Instruction;
+
+// A compiled program translated to native x86-64 code in an executable mapping.
+// Registers and variables stay in the VM's arrays, builtins are called directly.
+class JitProgram {
+    public:
+    // registerCount is the size of the register file the code runs against. Returns nullptr
+    // if the host isn't x86-64 SysV, the code can't be mapped executable or a register lies
+    // outside registerCount, callers fall back to InstructionVM
+    static std::unique_ptr<JitProgram> compile(const std::vector<Instruction>& instructions, int registerCount, int resultRegister);
+    static bool isSupported();
+
+    ~JitProgram();
+    JitProgram(const JitProgram&) = delete;
+    JitProgram& operator=(const JitProgram&) = delete;
+
+    // Runs the program, returns the value of the result register
+    double execute(double* registers, double* variables) const {
+        return entry(registers, variables);
+    }
+
+    size_t getCodeSize() const;
+
+    private:
+    typedef double (*Entry_t)(double* registers, double* variables);
+
+    JitProgram(void* code, size_t size);
+
+    void* code;
+    size_t size;
+    Entry_t entry;
+};
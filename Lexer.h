@@ -1,17 +0,0 @@
-#pragma once
-
-#include <memory>
-
-class TokenList;
-class Calculator;
-
-class Lexer {
-    public:
-    Lexer(Calculator* calculator);
-    bool lexInput(TokenList& tokenList);
-    bool expandConstants(TokenList& tokenList);
-    void expandVariables(TokenList& tokenList);
-
-    Calculator* calculator;
-    private:
-};
\ No newline at end of file
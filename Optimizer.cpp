@@ -0,0 +1,450 @@
+#include "Optimizer.h"
+#include "Instruction.h"
+#include "Functions.h"
+#include "Arena.h"
+
+#include <map>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+
+namespace {
+    // Identity of a DAG node: the operation and everything it reads
+    struct NodeKey {
+        int operation;
+        int a;
+        int b;
+        int c;
+        uint64_t immediate;
+
+        bool operator==(const NodeKey& other) const {
+            return operation == other.operation && a == other.a && b == other.b && c == other.c && immediate == other.immediate;
+        }
+    };
+
+    struct NodeKeyHash {
+        size_t operator()(const NodeKey& key) const {
+            uint64_t h = key.immediate * 0x9E3779B97F4A7C15ull;
+            h ^= (uint64_t)key.operation + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+            h ^= (uint64_t)key.a + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+            h ^= (uint64_t)key.b + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+            h ^= (uint64_t)key.c + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+
+    typedef std::map<int, int, std::less<int>, ArenaAllocator<std::pair<const int, int>>> RegisterMap;
+}
+
+int Optimizer::optimize(std::vector<Instruction>& instructions, int& registerCount, int& resultRegister, Arena& arena) {
+    int originalSize = instructions.size();
+    foldConstants(instructions, registerCount, resultRegister, arena);
+    eliminateCommonSubexpressions(instructions, registerCount, resultRegister, arena);
+    eliminateDeadCode(instructions, registerCount, resultRegister, arena);
+    peephole(instructions, registerCount, resultRegister, arena);
+    eliminateDeadCode(instructions, registerCount, resultRegister, arena);
+    return originalSize - instructions.size();
+}
+
+void Optimizer::foldConstants(std::vector<Instruction>& instructions, int registerCount, int& resultRegister, Arena& arena) {
+    ArenaVector<bool> known(registerCount, false, arena);
+    ArenaVector<double> values(registerCount, 0., arena);
+    // Register renames for instructions that were removed, alias[r] == r if r is kept
+    ArenaVector<int> alias(registerCount, arena);
+    for(int r = 0; r < registerCount; ++r) {
+        alias[r] = r;
+    }
+    // Register holding the last value stored to each variable slot
+    RegisterMap storedSlots(arena);
+
+    ArenaVector<Instruction> folded(arena);
+    folded.reserve(instructions.size());
+
+    for(const auto &i : instructions) {
+        int operation = i.getOperation();
+        int dst = i.getDst();
+
+        if(operation == Instruction::OP_LOAD_CONSTANT) {
+            known[dst] = true;
+            values[dst] = i.getOperand().getValue();
+            folded.push_back(i);
+        } else if(operation == Instruction::OP_LOAD_VARIABLE) {
+            auto stored = storedSlots.find(i.getA());
+            if(stored != storedSlots.end()) {
+                alias[dst] = stored->second;
+                continue;
+            }
+            folded.push_back(i);
+        } else if(operation == Instruction::OP_STORE_VARIABLE) {
+            int a = alias[i.getA()];
+            storedSlots[i.getB()] = a;
+            folded.push_back(Instruction(operation, dst, a, i.getB(), 0, i.getOperand()));
+        } else if(Instruction::isBinaryOperation(operation)) {
+            int a = alias[i.getA()];
+            int b = alias[i.getB()];
+            if(known[a] && known[b]) {
+                known[dst] = true;
+                values[dst] = Instruction::evaluate(operation, values[a], values[b]);
+                folded.push_back(Instruction(Instruction::OP_LOAD_CONSTANT, dst, 0, 0, 0, Operand(Operand::TYPE_NUMBER, values[dst])));
+                continue;
+            }
+
+            // Note x+0 turns -0 into +0 where x does not, the sign of zero is not preserved
+            int identity = -1;
+            switch(operation) {
+                case Instruction::OP_ADD:
+                    if(known[b] && values[b] == 0.) identity = a;
+                    else if(known[a] && values[a] == 0.) identity = b;
+                    break;
+                case Instruction::OP_SUB:
+                    if(known[b] && values[b] == 0.) identity = a;
+                    break;
+                case Instruction::OP_MUL:
+                    if(known[b] && values[b] == 1.) identity = a;
+                    else if(known[a] && values[a] == 1.) identity = b;
+                    break;
+                case Instruction::OP_DIV:
+                case Instruction::OP_POW:
+                    if(known[b] && values[b] == 1.) identity = a;
+                    break;
+            }
+
+            if(identity >= 0) {
+                alias[dst] = identity;
+                continue;
+            }
+            folded.push_back(Instruction(operation, dst, a, b));
+        } else if(operation >= Instruction::OP_CALL1 && operation <= Instruction::OP_CALL3) {
+            int functionId = i.getOperand().getFunctionId();
+            const FunctionDefinition_t& function = Functions::get(functionId);
+            int args[] = {i.getA(), i.getB(), i.getC()};
+            for(int p = 0; p < function.arity; ++p) {
+                args[p] = alias[args[p]];
+            }
+
+            bool allKnown = function.pure;
+            double argValues[3] = {0., 0., 0.};
+            for(int p = 0; p < function.arity; ++p) {
+                allKnown = allKnown && known[args[p]];
+                argValues[p] = values[args[p]];
+            }
+
+            if(allKnown) {
+                known[dst] = true;
+                values[dst] = Functions::call(functionId, argValues);
+                folded.push_back(Instruction(Instruction::OP_LOAD_CONSTANT, dst, 0, 0, 0, Operand(Operand::TYPE_NUMBER, values[dst])));
+                continue;
+            }
+            folded.push_back(Instruction(operation, dst, args[0], args[1], args[2], i.getOperand()));
+        } else {
+            folded.push_back(i);
+        }
+    }
+
+    if(resultRegister >= 0) {
+        resultRegister = alias[resultRegister];
+    }
+    instructions.assign(folded.begin(), folded.end());
+}
+
+void Optimizer::eliminateCommonSubexpressions(std::vector<Instruction>& instructions, int registerCount, int& resultRegister, Arena& arena) {
+    ArenaVector<int> alias(registerCount, arena);
+    for(int r = 0; r < registerCount; ++r) {
+        alias[r] = r;
+    }
+
+    std::unordered_map<NodeKey, int, NodeKeyHash, std::equal_to<NodeKey>, ArenaAllocator<std::pair<const NodeKey, int>>> nodes(instructions.size(), NodeKeyHash(), std::equal_to<NodeKey>(), arena);
+
+    ArenaVector<Instruction> unique(arena);
+    unique.reserve(instructions.size());
+
+    for(const auto &i : instructions) {
+        int operation = i.getOperation();
+        NodeKey key = {operation, 0, 0, 0, 0};
+
+        if(operation == Instruction::OP_LOAD_CONSTANT) {
+            double value = i.getOperand().getValue();
+            std::memcpy(&key.immediate, &value, sizeof(value));
+        } else if(operation == Instruction::OP_LOAD_VARIABLE) {
+            key.a = i.getA();
+        } else if(operation == Instruction::OP_STORE_VARIABLE) {
+            // A store changes what later loads of the slot read, forget the earlier load
+            nodes.erase(NodeKey{Instruction::OP_LOAD_VARIABLE, i.getB(), 0, 0, 0});
+            unique.push_back(Instruction(operation, i.getDst(), alias[i.getA()], i.getB(), 0, i.getOperand()));
+            continue;
+        } else if(Instruction::isBinaryOperation(operation)) {
+            key.a = alias[i.getA()];
+            key.b = alias[i.getB()];
+            // Addition and multiplication commute exactly in IEEE arithmetic
+            if((operation == Instruction::OP_ADD || operation == Instruction::OP_MUL) && key.b < key.a) {
+                std::swap(key.a, key.b);
+            }
+        } else if(operation >= Instruction::OP_CALL1 && operation <= Instruction::OP_CALL3) {
+            int arity = operation - Instruction::OP_CALL1 + 1;
+            key.a = alias[i.getA()];
+            key.b = arity >= 2 ? alias[i.getB()] : 0;
+            key.c = arity >= 3 ? alias[i.getC()] : 0;
+            key.immediate = i.getOperand().getFunctionId();
+            if(!Functions::get(i.getOperand().getFunctionId()).pure) {
+                unique.push_back(Instruction(operation, i.getDst(), key.a, key.b, key.c, i.getOperand()));
+                continue;
+            }
+        }
+
+        auto existing = nodes.find(key);
+        if(existing != nodes.end()) {
+            alias[i.getDst()] = existing->second;
+            continue;
+        }
+        nodes.emplace(key, i.getDst());
+
+        if(operation == Instruction::OP_LOAD_CONSTANT || operation == Instruction::OP_LOAD_VARIABLE) {
+            unique.push_back(i);
+        } else {
+            unique.push_back(Instruction(operation, i.getDst(), key.a, key.b, key.c, i.getOperand()));
+        }
+    }
+
+    if(resultRegister >= 0) {
+        resultRegister = alias[resultRegister];
+    }
+    instructions.assign(unique.begin(), unique.end());
+}
+
+int Optimizer::eliminateDeadCode(std::vector<Instruction>& instructions, int registerCount, int resultRegister, Arena& arena) {
+    ArenaVector<bool> live(registerCount, false, arena);
+    if(resultRegister >= 0) {
+        live[resultRegister] = true;
+    }
+
+    ArenaVector<bool> keep(instructions.size(), false, arena);
+    for(int index = instructions.size() - 1; index >= 0; --index) {
+        const Instruction& i = instructions[index];
+
+        int destinations[2];
+        int destinationCount = i.getDestinations(destinations);
+        // Stores are visible after execution and are always kept
+        bool isLive = i.getOperation() == Instruction::OP_STORE_VARIABLE;
+        for(int d = 0; d < destinationCount; ++d) {
+            isLive = isLive || live[destinations[d]];
+        }
+        if(!isLive) {
+            continue;
+        }
+        keep[index] = true;
+
+        int sources[3];
+        int sourceCount = i.getSources(sources);
+        for(int source = 0; source < sourceCount; ++source) {
+            live[sources[source]] = true;
+        }
+    }
+
+    int removed = 0;
+    ArenaVector<Instruction> kept(arena);
+    kept.reserve(instructions.size());
+    for(int index = 0; index < instructions.size(); ++index) {
+        if(keep[index]) {
+            kept.push_back(instructions[index]);
+        } else {
+            removed++;
+        }
+    }
+    instructions.assign(kept.begin(), kept.end());
+    return removed;
+}
+
+void Optimizer::peephole(std::vector<Instruction>& instructions, int& registerCount, int& resultRegister, Arena& arena) {
+    ArenaVector<bool> known(registerCount, false, arena);
+    ArenaVector<double> values(registerCount, 0., arena);
+    ArenaVector<int> uses(registerCount, 0, arena);
+    // Index in the rewritten program of the instruction defining each register
+    ArenaVector<int> definitions(registerCount, -1, arena);
+
+    static const int sinId = Functions::find("sin");
+    static const int cosId = Functions::find("cos");
+    static const int sqrtId = Functions::find("sqrt");
+
+    // Argument register -> register holding cos of it, for pairing with sin
+    RegisterMap cosOf(arena);
+    RegisterMap sinOf(arena);
+    for(const auto &i : instructions) {
+        int sources[3];
+        int sourceCount = i.getSources(sources);
+        for(int source = 0; source < sourceCount; ++source) {
+            uses[sources[source]]++;
+        }
+        if(i.getOperation() == Instruction::OP_LOAD_CONSTANT) {
+            known[i.getDst()] = true;
+            values[i.getDst()] = i.getOperand().getValue();
+        } else if(i.getOperation() == Instruction::OP_CALL1 && i.getOperand().getFunctionId() == cosId) {
+            cosOf.emplace(i.getA(), i.getDst());
+        } else if(i.getOperation() == Instruction::OP_CALL1 && i.getOperand().getFunctionId() == sinId) {
+            sinOf.emplace(i.getA(), i.getDst());
+        }
+    }
+    if(resultRegister >= 0) {
+        uses[resultRegister]++;
+    }
+
+    ArenaVector<Instruction> rewritten(arena);
+    rewritten.reserve(instructions.size());
+    auto emit = [&](const Instruction& instruction) {
+        int destinations[2];
+        int destinationCount = instruction.getDestinations(destinations);
+        for(int d = 0; d < destinationCount; ++d) {
+            definitions[destinations[d]] = rewritten.size();
+        }
+        rewritten.push_back(instruction);
+    };
+    // The MUL defining register r if its only use is the instruction being rewritten
+    auto singleUseMultiply = [&](int r) -> const Instruction* {
+        if(uses[r] != 1 || definitions[r] < 0) {
+            return nullptr;
+        }
+        const Instruction& definition = rewritten[definitions[r]];
+        return definition.getOperation() == Instruction::OP_MUL ? &definition : nullptr;
+    };
+
+    for(const auto &i : instructions) {
+        int operation = i.getOperation();
+        int dst = i.getDst();
+        int a = i.getA();
+        int b = i.getB();
+
+        if(operation == Instruction::OP_CALL1 && (i.getOperand().getFunctionId() == sinId || i.getOperand().getFunctionId() == cosId)) {
+            bool isSin = i.getOperand().getFunctionId() == sinId;
+            auto pair = isSin ? cosOf.find(a) : sinOf.find(a);
+            if(pair != (isSin ? cosOf.end() : sinOf.end())) {
+                // Both are computed at whichever of the two comes first, the other is dropped
+                if(definitions[pair->second] < 0) {
+                    int sinDst = isSin ? dst : pair->second;
+                    int cosDst = isSin ? pair->second : dst;
+                    emit(Instruction(Instruction::OP_SINCOS, sinDst, a, cosDst));
+                }
+                continue;
+            }
+            emit(i);
+        } else if(operation == Instruction::OP_POW && known[b]) {
+            double exponent = values[b];
+            if(exponent == 2.) {
+                emit(Instruction(Instruction::OP_MUL, dst, a, a));
+            } else if(exponent == 3.) {
+                int square = registerCount++;
+                known.push_back(false);
+                values.push_back(0.);
+                uses.push_back(1);
+                definitions.push_back(-1);
+                emit(Instruction(Instruction::OP_MUL, square, a, a));
+                emit(Instruction(Instruction::OP_MUL, dst, square, a));
+            } else if(exponent == 0.5) {
+                // Differs from pow only for -0 (gives -0 not +0) and -inf (gives NaN not +inf)
+                emit(Instruction(Instruction::OP_CALL1, dst, a, 0, 0, Operand(Operand::TYPE_FUNCTION, sqrtId)));
+            } else {
+                emit(Instruction(Instruction::OP_POWK, dst, a, 0, 0, Operand(Operand::TYPE_NUMBER, exponent)));
+            }
+            uses[b]--;
+        } else if(operation == Instruction::OP_ADD && !known[a] && !known[b] && (singleUseMultiply(a) || singleUseMultiply(b))) {
+            const Instruction* multiply = singleUseMultiply(a);
+            int addend = b;
+            if(multiply == nullptr) {
+                multiply = singleUseMultiply(b);
+                addend = a;
+            }
+            // The MUL is now unused and removed by dead code elimination
+            emit(Instruction(Instruction::OP_MULADD, dst, multiply->getA(), multiply->getB(), addend));
+            uses[multiply->getDst()]--;
+        } else if(Instruction::isBinaryOperation(operation) && known[b]) {
+            static const int immediateOperations[] = {
+                Instruction::OP_ADDK, Instruction::OP_SUBK, Instruction::OP_MULK,
+                Instruction::OP_DIVK, Instruction::OP_POWK, Instruction::OP_MODK
+            };
+            emit(Instruction(immediateOperations[operation - Instruction::OP_ADD], dst, a, 0, 0, Operand(Operand::TYPE_NUMBER, values[b])));
+            uses[b]--;
+        } else if(Instruction::isBinaryOperation(operation) && known[a]) {
+            int immediateOperation = -1;
+            switch(operation) {
+                case Instruction::OP_ADD: immediateOperation = Instruction::OP_ADDK; break;
+                case Instruction::OP_MUL: immediateOperation = Instruction::OP_MULK; break;
+                case Instruction::OP_SUB: immediateOperation = Instruction::OP_KSUB; break;
+                case Instruction::OP_DIV: immediateOperation = Instruction::OP_KDIV; break;
+            }
+            if(immediateOperation < 0) {
+                emit(i);
+                continue;
+            }
+            emit(Instruction(immediateOperation, dst, b, 0, 0, Operand(Operand::TYPE_NUMBER, values[a])));
+            uses[a]--;
+        } else {
+            emit(i);
+        }
+    }
+
+    instructions.assign(rewritten.begin(), rewritten.end());
+}
+
+void Optimizer::compactRegisters(std::vector<Instruction>& instructions, int& registerCount, int& resultRegister, Arena& arena) {
+    // Index of the last instruction reading each register, the result is read after the program
+    ArenaVector<int> lastRead(registerCount, -1, arena);
+    int sources[3];
+    int destinations[2];
+    for(int index = 0; index < instructions.size(); ++index) {
+        int count = instructions[index].getSources(sources);
+        for(int s = 0; s < count; ++s) {
+            lastRead[sources[s]] = index;
+        }
+    }
+    if(resultRegister >= 0) {
+        lastRead[resultRegister] = instructions.size();
+    }
+
+    ArenaVector<int> physical(registerCount, -1, arena);
+    ArenaVector<int> freeRegisters(arena);
+    int peak = 0;
+
+    for(int index = 0; index < instructions.size(); ++index) {
+        const Instruction& i = instructions[index];
+        int fields[3] = {i.getA(), i.getB(), i.getC()};
+        int sourceCount = i.getSources(sources);
+        for(int s = 0; s < sourceCount; ++s) {
+            fields[s] = physical[sources[s]];
+        }
+
+        // Destinations are allocated before sources are released, so no instruction writes a
+        // register it is still reading
+        int destinationCount = i.getDestinations(destinations);
+        for(int d = 0; d < destinationCount; ++d) {
+            int r = destinations[d];
+            if(freeRegisters.empty()) {
+                physical[r] = peak++;
+            } else {
+                physical[r] = freeRegisters.back();
+                freeRegisters.pop_back();
+            }
+        }
+
+        for(int s = 0; s < sourceCount; ++s) {
+            // Marked so a register read twice by one instruction is released once
+            if(lastRead[sources[s]] == index) {
+                lastRead[sources[s]] = -1;
+                freeRegisters.push_back(physical[sources[s]]);
+            }
+        }
+        for(int d = 0; d < destinationCount; ++d) {
+            if(lastRead[destinations[d]] < index) {
+                freeRegisters.push_back(physical[destinations[d]]);
+            }
+        }
+
+        int dst = i.getDst() < 0 ? i.getDst() : physical[i.getDst()];
+        if(i.getOperation() == Instruction::OP_SINCOS) {
+            fields[1] = physical[i.getB()];
+        }
+        instructions[index] = Instruction(i.getOperation(), dst, fields[0], fields[1], fields[2], i.getOperand());
+    }
+
+    if(resultRegister >= 0) {
+        resultRegister = physical[resultRegister];
+    }
+    registerCount = peak;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+
+class Instruction;
+class Arena;
+
+// Passes over compiled register bytecode. Every register is written by exactly one
+// instruction, so passes can rename registers freely before dead code is removed.
+// Scratch data comes from the caller's arena, which must outlive the call.
+class Optimizer {
+    public:
+    // Runs all passes, returns the number of instructions removed
+    static int optimize(std::vector<Instruction>& instructions, int& registerCount, int& resultRegister, Arena& arena);
+
+    // Evaluates instructions whose operands are all known at compile time and removes
+    // identity operations (x*1, 1*x, x+0, 0+x, x-0, x/1, x^1). Variables stored earlier in
+    // the program are forwarded to later loads. Folded instructions become constant loads.
+    static void foldConstants(std::vector<Instruction>& instructions, int registerCount, int& resultRegister, Arena& arena);
+
+    // Hash-conses the program into an expression DAG: an instruction computing the same
+    // operation on the same operands as an earlier one is removed and its uses renamed
+    // to the earlier register, so each unique subexpression is evaluated once
+    static void eliminateCommonSubexpressions(std::vector<Instruction>& instructions, int registerCount, int& resultRegister, Arena& arena);
+
+    // Strength reduction and superinstructions: x^2 and x^3 become multiplies, x^0.5 sqrt,
+    // operators with a constant operand take it as an immediate, a*b+c becomes MULADD and
+    // sin/cos of the same register share one SINCOS. May allocate new registers.
+    static void peephole(std::vector<Instruction>& instructions, int& registerCount, int& resultRegister, Arena& arena);
+
+    // Removes instructions whose result is never read, returns the number removed
+    static int eliminateDeadCode(std::vector<Instruction>& instructions, int registerCount, int resultRegister, Arena& arena);
+
+    // Reassigns registers so ones whose value is dead are reused, registerCount becomes the
+    // most registers live at once. Ends single assignment, so it runs after every other pass.
+    static void compactRegisters(std::vector<Instruction>& instructions, int& registerCount, int& resultRegister, Arena& arena);
+};
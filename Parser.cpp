@@ -3,147 +3,198 @@
 #include "TokenList.h"
 #include "Calculator.h"
 
-Parser::Parser(Calculator* calculator) : calculator(calculator) {
-}
+#include <math.h>
+#include <charconv>
 
-bool Parser::isCharNumeric(char i) {
-    return (i >= '0' && i <= '9') || i == '.';
+Parser::Parser(Calculator* calculator) : calculator(calculator) {
 }
 
-bool Parser::isCharHex(char i) {
-    return (i >= '0' && i <= '9') || (tolower(i) >= 'a' && tolower(i) <= 'f') || tolower(i) == 'x';
-}
+// Assignment binds loosest so "a=1+2" assigns 3
+constexpr std::array<Operator_t, 7> Parser::operators = {{
+    {'=', 0},
+    {'+', 1},
+    {'-', 1},
+    {'*', 2},
+    {'/', 2},
+    {'%', 2},
+    {'^', 3}
+}};
+
+static constexpr std::array<Parser::CharInfo, 256> buildCharTable() {
+    std::array<Parser::CharInfo, 256> table = {};
+    for(int c = 0; c < 256; ++c) {
+        bool digit = c >= '0' && c <= '9';
+        bool upper = c >= 'A' && c <= 'Z';
+        bool lower = c >= 'a' && c <= 'z';
+        bool hexLetter = (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F') || c == 'x' || c == 'X';
+
+        Parser::CharInfo& info = table[c];
+        info.precedence = -1;
+        info.tokenType = Token::TOKEN_UNKNOWN;
+        if(digit || c == '.') info.classes |= Parser::CLASS_NUMERIC;
+        if(digit || hexLetter) info.classes |= Parser::CLASS_HEX;
+        if(upper || lower) info.classes |= Parser::CLASS_IDENTIFIER_START;
+        if(upper || lower || digit) info.classes |= Parser::CLASS_IDENTIFIER;
+        if(c == '(' || c == ')') info.classes |= Parser::CLASS_PARENTHESIS;
+        for(auto &o : Parser::operators) {
+            if(c == o.first) {
+                info.classes |= Parser::CLASS_OPERATOR;
+                info.precedence = o.second;
+            }
+        }
 
-bool Parser::isCharOperator(char i) {
-    for(auto &o : operators) {
-        if(i == o.first)
-            return true;
+        if(c == ' ') info.tokenType = Token::TOKEN_WHITESPACE;
+        else if(info.classes & Parser::CLASS_NUMERIC) info.tokenType = Token::TOKEN_NUMBER;
+        else if(info.classes & Parser::CLASS_OPERATOR) info.tokenType = Token::TOKEN_OPERATOR;
+        else if(c == '(') info.tokenType = Token::TOKEN_OPEN_PARENTHESIS;
+        else if(c == ')') info.tokenType = Token::TOKEN_CLOSE_PARENTHESIS;
+        else if(c == ',') info.tokenType = Token::TOKEN_COMMA;
+        else if(info.classes & Parser::CLASS_IDENTIFIER_START) info.tokenType = Token::TOKEN_IDENTIFIER;
+        else if(c == ';') info.tokenType = Token::TOKEN_SEMICOLON;
     }
-    return false;
-}
-
-bool Parser::isCharComma(char i) {
-    return i == ',';
-}
-
-bool Parser::isCharIdentifierStart(char i) {
-    return isalpha(i);
+    return table;
 }
 
-bool Parser::isCharIdentifier(char i) {
-    return isalnum(i);
-}
+constexpr std::array<Parser::CharInfo, 256> Parser::charTable = buildCharTable();
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+typedef __m256i Bytes;
+static const size_t bytesWidth = 32;
+static inline Bytes loadBytes(const char* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline Bytes broadcastByte(char c) { return _mm256_set1_epi8(c); }
+static inline Bytes orBytes(Bytes a, Bytes b) { return _mm256_or_si256(a, b); }
+static inline Bytes equalBytes(Bytes a, Bytes b) { return _mm256_cmpeq_epi8(a, b); }
+// Signed compares, so bytes >= 0x80 are never in a range
+static inline Bytes rangeBytes(Bytes v, char lo, char hi) { return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v)); }
+static inline uint32_t maskBytes(Bytes v) { return (uint32_t)_mm256_movemask_epi8(v); }
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128i Bytes;
+static const size_t bytesWidth = 16;
+static inline Bytes loadBytes(const char* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline Bytes broadcastByte(char c) { return _mm_set1_epi8(c); }
+static inline Bytes orBytes(Bytes a, Bytes b) { return _mm_or_si128(a, b); }
+static inline Bytes equalBytes(Bytes a, Bytes b) { return _mm_cmpeq_epi8(a, b); }
+static inline Bytes rangeBytes(Bytes v, char lo, char hi) { return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1))); }
+static inline uint32_t maskBytes(Bytes v) { return (uint32_t)_mm_movemask_epi8(v); }
+#endif
+
+size_t Parser::scanRun(std::string_view input, size_t start, int classes) {
+    const char* data = input.data();
+    size_t i = start;
+    size_t size = input.size();
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Vector forms of the classes runs are made of, anything else goes byte by byte
+    const uint32_t fullMask = bytesWidth == 32 ? 0xFFFFFFFFu : 0xFFFFu;
+    while(i + bytesWidth <= size) {
+        Bytes v = loadBytes(data + i);
+        Bytes member;
+        if(classes == CLASS_IDENTIFIER) {
+            member = orBytes(rangeBytes(v, '0', '9'), orBytes(rangeBytes(v, 'a', 'z'), rangeBytes(v, 'A', 'Z')));
+        } else if(classes == (CLASS_NUMERIC | CLASS_HEX)) {
+            member = orBytes(orBytes(rangeBytes(v, '0', '9'), equalBytes(v, broadcastByte('.'))),
+                orBytes(orBytes(rangeBytes(v, 'a', 'f'), rangeBytes(v, 'A', 'F')),
+                    orBytes(equalBytes(v, broadcastByte('x')), equalBytes(v, broadcastByte('X')))));
+        } else {
+            break;
+        }
 
-bool Parser::isCharOpenParenthesis(char i) {
-    return i == '(';
-}
+        uint32_t mask = maskBytes(member);
+        if(mask != fullMask) {
+            return i + __builtin_ctz(~mask);
+        }
+        i += bytesWidth;
+    }
+#endif
 
-bool Parser::isCharCloseParenthesis(char i) {
-    return i == ')';
+    while(i < size && (charTable[(unsigned char)data[i]].classes & classes)) {
+        i++;
+    }
+    return i;
 }
 
-bool Parser::isCharParenthesis(char i) {
-    return Parser::isCharOpenParenthesis(i) || Parser::isCharCloseParenthesis(i);
-}
+// Hex digits accumulate exactly up to 2^53, "0x" literals are integers in practice
+static double parseHexNumber(std::string_view digits) {
+    if(digits.empty()) {
+        return NAN;
+    }
 
-bool Parser::isCharSemiColon(char i) {
-    return i == ';';
+    double value = 0.;
+    double scale = 0.;
+    for(char c : digits) {
+        int digit;
+        if(c >= '0' && c <= '9') digit = c - '0';
+        else if(c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else if(c == '.' && scale == 0.) { scale = 1.; continue; }
+        else return NAN;
+
+        if(scale == 0.) {
+            value = value * 16. + digit;
+        } else {
+            scale /= 16.;
+            value += digit * scale;
+        }
+    }
+    return value;
 }
 
-int Parser::tokenTypeFromChar(int i) {
-    if (i == ' ') {
-        return Token::TOKEN_WHITESPACE;
-    } else if (Parser::isCharNumeric(i)) {
-        return Token::TOKEN_NUMBER;
-    } else if (Parser::isCharOperator(i)) {
-        return Token::TOKEN_OPERATOR;
-    } else if (Parser::isCharOpenParenthesis(i)) {
-        return Token::TOKEN_OPEN_PARENTHESIS;
-    } else if (Parser::isCharCloseParenthesis(i)) {
-        return Token::TOKEN_CLOSE_PARENTHESIS;
-    } else if (Parser::isCharComma(i)) {
-        return Token::TOKEN_COMMA;
-    } else if (Parser::isCharIdentifierStart(i)) {
-        return Token::TOKEN_IDENTIFIER;
-    } else if (Parser::isCharSemiColon(i)) {
-        return Token::TOKEN_SEMICOLON;
-    } else {
-        return Token::TOKEN_UNKNOWN;
+double Parser::parseNumber(std::string_view text) {
+    if(text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        return parseHexNumber(text.substr(2));
     }
-}
 
-const std::vector<Operator_t> Parser::operators = {
-    {'+', 1},
-    {'-', 1},
-    {'*', 2},
-    {'/', 2},
-    {'%', 2},
-    {'^', 3},
-    {'=', 4}
-};
+    // from_chars is locale independent, correctly rounded and needs no terminator
+    double value = NAN;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size() ? value : NAN;
+}
 
 bool Parser::parseInput(std::string_view input, TokenList& tokenList) {
-    int lastTokenType = Token::TOKEN_NULL;
-    std::string buf = "";
-
-    for(auto &i : input) {
-        int tokenType = Parser::tokenTypeFromChar(i);
-
-        //Allow hex literals
-        if(lastTokenType == Token::TOKEN_NUMBER && Parser::isCharHex(i)) {
-            tokenType = Token::TOKEN_NUMBER;
-        }
-
-        if(lastTokenType == Token::TOKEN_IDENTIFIER && Parser::isCharIdentifier(i)) {
-            tokenType = Token::TOKEN_IDENTIFIER;
-        }
-
-        if(tokenType == Token::TOKEN_CLOSE_PARENTHESIS) {
-            if(buf.size() == 1 && Parser::isCharCloseParenthesis(buf[0])) {
-                tokenList.list.push_back({Token::TOKEN_CLOSE_PARENTHESIS, buf});
-                buf = "";
-            }
-        }
-
-        if(tokenType == Token::TOKEN_OPEN_PARENTHESIS) {
-            if(buf.size() == 1 && Parser::isCharOpenParenthesis(buf[0])) {
-                tokenList.list.push_back({Token::TOKEN_OPEN_PARENTHESIS, buf});
-                buf = "";
-            }
-        }
-
-        if(tokenType != lastTokenType) {
-            if(lastTokenType != Token::TOKEN_NULL) {
-                tokenList.list.push_back({lastTokenType, buf});
+    tokenList.source.assign(input.data(), input.size());
+    tokenList.list.clear();
+
+    size_t i = 0;
+    while(i < input.size()) {
+        size_t start = i;
+        int tokenType = Parser::tokenTypeFromChar(input[i]);
+        i++;
+
+        if(tokenType == Token::TOKEN_NUMBER) {
+            //Allow hex literals
+            i = scanRun(input, i, CLASS_NUMERIC | CLASS_HEX);
+        } else if(tokenType == Token::TOKEN_IDENTIFIER) {
+            i = scanRun(input, i, CLASS_IDENTIFIER);
+        } else if(tokenType != Token::TOKEN_OPEN_PARENTHESIS && tokenType != Token::TOKEN_CLOSE_PARENTHESIS) {
+            // Runs of anything else of the same type are one token, parentheses are always their own
+            while(i < input.size() && Parser::tokenTypeFromChar(input[i]) == tokenType) {
+                i++;
             }
-            buf = "";
-
-            lastTokenType = tokenType;
         }
-        buf += i;
-    }
 
-    if(buf != "") {
-        if(lastTokenType != Token::TOKEN_NULL) {
-            tokenList.list.push_back({lastTokenType, buf});
+        Token token(tokenType, start, i - start);
+        if(tokenType == Token::TOKEN_NUMBER) {
+            token.setNumber(parseNumber(input.substr(start, i - start)));
         }
+        tokenList.list.push_back(token);
     }
 
     return true;
 }
 
-void Parser::preprocessInput(std::string_view input, std::vector<std::string>& lines) {
+void Parser::preprocessInput(std::string_view input, ArenaVector<std::string_view>& lines) {
+    // Each line keeps its leading ';' so the lines tile the input exactly
     lines.clear();
-    std::string buf = "";
-    for(auto &i : input) {
-        if(i == ';') {
-            lines.push_back(buf);
-            buf = "";
+    size_t start = 0;
+    for(size_t i = 0; i < input.size(); ++i) {
+        if(input[i] == ';') {
+            lines.push_back(input.substr(start, i - start));
+            start = i;
         }
-        
-        buf += i;
     }
-    if(buf != "") {
-        lines.push_back(buf);
-    }   
-}
\ No newline at end of file
+    if(start < input.size()) {
+        lines.push_back(input.substr(start));
+    }
+}
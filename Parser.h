@@ -2,7 +2,11 @@
 
 #include <string>
 #include <vector>
+#include <array>
 #include <string_view>
+#include <cstdint>
+
+#include "Arena.h"
 
 typedef std::pair<char, int> Operator_t;
 
@@ -11,24 +15,54 @@ class Calculator;
 class Parser {
 public:
     Parser(Calculator* calculator);
-    static bool isCharNumeric(char i);
-    static bool isCharHex(char i);
-    static bool isCharOperator(char i);
-    static bool isCharComma(char i);
-    static bool isCharIdentifierStart(char i);
-    static bool isCharIdentifier(char i);
-    static bool isCharOpenParenthesis(char i);
-    static bool isCharCloseParenthesis(char i);
-    static bool isCharParenthesis(char i);
-    static bool isCharSemiColon(char i);
-
-    static int tokenTypeFromChar(int i);
+
+    enum CharClass {
+        CLASS_NUMERIC = 1 << 0,             // digits and '.'
+        CLASS_HEX = 1 << 1,                 // digits, a-f and x, continue a number
+        CLASS_IDENTIFIER_START = 1 << 2,
+        CLASS_IDENTIFIER = 1 << 3,
+        CLASS_OPERATOR = 1 << 4,
+        CLASS_PARENTHESIS = 1 << 5
+    };
+
+    // Everything the tokenizer needs to know about a byte, built at compile time
+    struct CharInfo {
+        uint8_t classes;
+        int8_t tokenType;
+        int8_t precedence;  // -1 unless the byte is a binary operator
+    };
+    static const std::array<CharInfo, 256> charTable;
+
+    static bool isCharNumeric(char i) { return charInfo(i).classes & CLASS_NUMERIC; }
+    static bool isCharHex(char i) { return charInfo(i).classes & CLASS_HEX; }
+    static bool isCharOperator(char i) { return charInfo(i).classes & CLASS_OPERATOR; }
+    static bool isCharComma(char i) { return i == ','; }
+    static bool isCharIdentifierStart(char i) { return charInfo(i).classes & CLASS_IDENTIFIER_START; }
+    static bool isCharIdentifier(char i) { return charInfo(i).classes & CLASS_IDENTIFIER; }
+    static bool isCharOpenParenthesis(char i) { return i == '('; }
+    static bool isCharCloseParenthesis(char i) { return i == ')'; }
+    static bool isCharParenthesis(char i) { return charInfo(i).classes & CLASS_PARENTHESIS; }
+    static bool isCharSemiColon(char i) { return i == ';'; }
+
+    static int tokenTypeFromChar(int i) { return charInfo(i).tokenType; }
+    static int getPrecedence(char symbol) { return charInfo(symbol).precedence; }
 
     // Operator and precedence
-    static const std::vector<Operator_t> operators;
+    static const std::array<Operator_t, 7> operators;
 
+    // Replaces the contents of tokenList with the tokens of input, reusing its buffers
     bool parseInput(std::string_view input, TokenList& tokenList);
-    void preprocessInput(std::string_view input, std::vector<std::string>& lines);
+    // Splits input into statements, the views point into input
+    void preprocessInput(std::string_view input, ArenaVector<std::string_view>& lines);
+    // Parses a whole numeric literal, NaN if any of it is left over
+    static double parseNumber(std::string_view text);
+    // End of the run starting at start whose bytes all have one of classes, checks
+    // 16 or 32 bytes per step where SSE2 or AVX2 is available
+    static size_t scanRun(std::string_view input, size_t start, int classes);
 private:
+    static const CharInfo& charInfo(int i) {
+        return charTable[(unsigned char)i];
+    }
+
     Calculator* calculator;
 };
\ No newline at end of file
@@ -0,0 +1,443 @@
+#include "Program.h"
+#include "Functions.h"
+#include "Builtins.h"
+#include "Arena.h"
+
+#include <unordered_map>
+#include <cstring>
+#include <math.h>
+#include <algorithm>
+
+static_assert((int)Program::OP_LOAD_CONSTANT == Instruction::OP_LOAD_CONSTANT && (int)Program::OP_CALL1 == Instruction::OP_CALL1
+    && (int)Program::OP_ADDK == Instruction::OP_ADDK && (int)Program::OP_SINCOS == Instruction::OP_SINCOS,
+    "Program opcodes below the builtins are Instruction's operations");
+
+namespace {
+    template<typename Function_t>
+    struct BuiltinOpcode {
+        Function_t function;
+        int opcode;
+    };
+
+    const BuiltinOpcode<Function1_t> unaryBuiltins[] = {
+        {Builtins::saturate, Program::OP_SATURATE},
+        {Builtins::sin, Program::OP_SIN},
+        {Builtins::cos, Program::OP_COS},
+        {Builtins::tan, Program::OP_TAN},
+        {Builtins::asin, Program::OP_ASIN},
+        {Builtins::acos, Program::OP_ACOS},
+        {Builtins::atan, Program::OP_ATAN},
+        {Builtins::cosh, Program::OP_COSH},
+        {Builtins::tanh, Program::OP_TANH},
+        {Builtins::asinh, Program::OP_ASINH},
+        {Builtins::acosh, Program::OP_ACOSH},
+        {Builtins::atanh, Program::OP_ATANH},
+        {Builtins::sqrt, Program::OP_SQRT},
+        {Builtins::cbrt, Program::OP_CBRT},
+        {Builtins::rsqrt, Program::OP_RSQRT},
+        {Builtins::abs, Program::OP_ABS},
+        {Builtins::sign, Program::OP_SIGN},
+        {Builtins::exp, Program::OP_EXP},
+        {Builtins::exp2, Program::OP_EXP2},
+        {Builtins::exp10, Program::OP_EXP10},
+        {Builtins::log, Program::OP_LOG},
+        {Builtins::log2, Program::OP_LOG2},
+        {Builtins::log10, Program::OP_LOG10},
+        {Builtins::ceil, Program::OP_CEIL},
+        {Builtins::floor, Program::OP_FLOOR},
+        {Builtins::round, Program::OP_ROUND},
+        {Builtins::fract, Program::OP_FRACT},
+    };
+
+    const BuiltinOpcode<Function2_t> binaryBuiltins[] = {
+        {Builtins::max, Program::OP_MAX},
+        {Builtins::min, Program::OP_MIN},
+        {Builtins::atan2, Program::OP_ATAN2},
+        {Builtins::pow, Program::OP_POW},
+    };
+
+    const BuiltinOpcode<Function3_t> ternaryBuiltins[] = {
+        {Builtins::clamp, Program::OP_CLAMP},
+    };
+
+    // Matched on the function pointer, so a builtin whose body changes falls back to a call
+    template<typename Function_t, size_t N>
+    int findOpcode(const BuiltinOpcode<Function_t> (&builtins)[N], Function_t function, int fallback) {
+        for(auto &i : builtins) {
+            if(i.function == function) {
+                return i.opcode;
+            }
+        }
+        return fallback;
+    }
+
+    size_t wordsFor(size_t bytes) {
+        return (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    }
+}
+
+Program::Program() {
+    clear();
+}
+
+bool Program::isExtended(int opcode) {
+    switch(opcode) {
+        case OP_CALL2:
+        case OP_CALL3:
+        case OP_MULADD:
+        case OP_CLAMP:
+            return true;
+    }
+    return false;
+}
+
+void Program::clear() {
+    words.assign(wordsFor(sizeof(Header)) + 1, 0);
+    Header* h = reinterpret_cast<Header*>(words.data());
+    h->stepCount = 1;
+    h->resultRegister = -1;
+    Step* end = reinterpret_cast<Step*>(words.data() + wordsFor(sizeof(Header)));
+    end->opcode = OP_END;
+}
+
+const char* Program::assign(const std::vector<Instruction>& instructions, int registerCount, int resultRegister,
+    std::span<const std::string> variableNames, Arena& arena) {
+    if(registerCount > maxIndex + 1) {
+        clear();
+        return "Expression needs too many registers";
+    }
+    // Only the slots the program references count, not every name bound
+    int slotCount = 0;
+    for(const auto &i : instructions) {
+        if(i.getOperation() == Instruction::OP_LOAD_VARIABLE) {
+            slotCount = std::max(slotCount, i.getA() + 1);
+        } else if(i.getOperation() == Instruction::OP_STORE_VARIABLE) {
+            slotCount = std::max(slotCount, i.getB() + 1);
+        }
+    }
+    if(slotCount > maxIndex + 1) {
+        clear();
+        return "Expression has too many variables";
+    }
+
+    ArenaVector<Step> steps(arena);
+    steps.reserve(instructions.size() + 1);
+    ArenaVector<double> constants(arena);
+    std::unordered_map<uint64_t, int, std::hash<uint64_t>, std::equal_to<uint64_t>, ArenaAllocator<std::pair<const uint64_t, int>>>
+        constantIndices(16, std::hash<uint64_t>(), std::equal_to<uint64_t>(), arena);
+    // Symbol index of each variable slot, or -1 if the program doesn't touch it
+    ArenaVector<int> slotSymbols(slotCount, -1, arena);
+    ArenaVector<int> symbolSlots(arena);
+
+    // Constants are pooled by bit pattern so 0. and -0. stay distinct
+    auto addConstant = [&](double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        auto [it, inserted] = constantIndices.emplace(bits, constants.size());
+        if(inserted) {
+            constants.push_back(value);
+        }
+        return it->second;
+    };
+    auto addSymbol = [&](int slot) {
+        if(slotSymbols[slot] < 0) {
+            slotSymbols[slot] = symbolSlots.size();
+            symbolSlots.push_back(slot);
+        }
+        return slot;
+    };
+
+    for(const auto &i : instructions) {
+        int operation = i.getOperation();
+        Step step = {(uint16_t)operation, (uint16_t)(i.getDst() < 0 ? 0 : i.getDst()), (uint16_t)i.getA(), (uint16_t)i.getB()};
+        int c = i.getC();
+        int function = 0;
+
+        switch(operation) {
+            case Instruction::OP_LOAD_CONSTANT:
+                step.a = addConstant(i.getOperand().getValue());
+                break;
+            case Instruction::OP_LOAD_VARIABLE:
+                step.a = addSymbol(i.getA());
+                break;
+            case Instruction::OP_STORE_VARIABLE:
+                step.b = addSymbol(i.getB());
+                break;
+            case Instruction::OP_CALL1:
+            case Instruction::OP_CALL2:
+            case Instruction::OP_CALL3: {
+                function = i.getOperand().getFunctionId();
+                const FunctionDefinition_t& definition = Functions::get(function);
+                if(operation == Instruction::OP_CALL1) {
+                    step.opcode = findOpcode(unaryBuiltins, definition.f1, OP_CALL1);
+                    if(step.opcode == OP_CALL1) {
+                        step.b = function;
+                    }
+                } else if(operation == Instruction::OP_CALL2) {
+                    step.opcode = findOpcode(binaryBuiltins, definition.f2, OP_CALL2);
+                } else {
+                    step.opcode = findOpcode(ternaryBuiltins, definition.f3, OP_CALL3);
+                }
+                break;
+            }
+            default:
+                if(Instruction::isImmediateOperation(operation)) {
+                    step.b = addConstant(i.getOperand().getValue());
+                }
+                break;
+        }
+        steps.push_back(step);
+
+        if(isExtended(step.opcode)) {
+            steps.push_back({OP_END, 0, (uint16_t)c, (uint16_t)function});
+        }
+    }
+    steps.push_back({OP_END, 0, 0, 0});
+
+    if(constants.size() > maxIndex + 1) {
+        clear();
+        return "Expression has too many constants";
+    }
+
+    size_t nameBytes = 0;
+    for(int slot : symbolSlots) {
+        nameBytes += variableNames[slot].size();
+    }
+
+    size_t constantsStart = wordsFor(sizeof(Header));
+    size_t stepsStart = constantsStart + constants.size();
+    size_t symbolsStart = stepsStart + steps.size();
+    size_t namesStart = symbolsStart + symbolSlots.size();
+    // assign rather than resize so stale padding never reaches hash() or ==
+    words.assign(namesStart + wordsFor(nameBytes), 0);
+
+    Header* h = reinterpret_cast<Header*>(words.data());
+    h->stepCount = steps.size();
+    h->constantCount = constants.size();
+    h->symbolCount = symbolSlots.size();
+    h->nameBytes = nameBytes;
+    h->registerCount = registerCount;
+    h->resultRegister = resultRegister;
+    for(int slot : symbolSlots) {
+        h->variableCount = std::max<uint32_t>(h->variableCount, slot + 1);
+    }
+
+    std::memcpy(words.data() + constantsStart, constants.data(), constants.size() * sizeof(double));
+    std::memcpy(words.data() + stepsStart, steps.data(), steps.size() * sizeof(Step));
+
+    Symbol* symbols = reinterpret_cast<Symbol*>(words.data() + symbolsStart);
+    char* names = reinterpret_cast<char*>(words.data() + namesStart);
+    uint32_t offset = 0;
+    for(int s = 0; s < symbolSlots.size(); ++s) {
+        const std::string& name = variableNames[symbolSlots[s]];
+        symbols[s] = {(uint16_t)symbolSlots[s], (uint16_t)name.size(), offset};
+        std::memcpy(names + offset, name.data(), name.size());
+        offset += name.size();
+    }
+    return nullptr;
+}
+
+const double* Program::getConstants() const {
+    return reinterpret_cast<const double*>(words.data() + wordsFor(sizeof(Header)));
+}
+
+const Program::Step* Program::getSteps() const {
+    return reinterpret_cast<const Step*>(getConstants() + header().constantCount);
+}
+
+const Program::Symbol* Program::getSymbols() const {
+    return reinterpret_cast<const Symbol*>(getSteps() + header().stepCount);
+}
+
+std::string_view Program::getSymbolName(const Symbol& symbol) const {
+    const char* names = reinterpret_cast<const char*>(getSymbols() + header().symbolCount);
+    return std::string_view(names + symbol.offset, symbol.length);
+}
+
+size_t Program::size() const {
+    return header().stepCount - 1;
+}
+
+size_t Program::getConstantCount() const {
+    return header().constantCount;
+}
+
+size_t Program::getSymbolCount() const {
+    return header().symbolCount;
+}
+
+int Program::getRegisterCount() const {
+    return header().registerCount;
+}
+
+int Program::getResultRegister() const {
+    return header().resultRegister;
+}
+
+int Program::getVariableCount() const {
+    return header().variableCount;
+}
+
+int Program::findSlot(std::string_view name) const {
+    const Symbol* symbols = getSymbols();
+    for(int i = 0; i < header().symbolCount; ++i) {
+        if(getSymbolName(symbols[i]) == name) {
+            return symbols[i].slot;
+        }
+    }
+    return -1;
+}
+
+size_t Program::getByteSize() const {
+    return words.size() * sizeof(uint64_t);
+}
+
+uint64_t Program::hash() const {
+    // FNV-1a over whole words
+    uint64_t h = 0xcbf29ce484222325ull;
+    for(uint64_t word : words) {
+        h = (h ^ word) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+bool Program::operator==(const Program& other) const {
+    return words == other.words;
+}
+
+void Program::execute(double* registers, double* variables) const {
+    double* r = registers;
+    double* v = variables;
+    const double* k = getConstants();
+    const Step* s = getSteps();
+
+#if defined(ADVANCEDCALC_COMPUTED_GOTO)
+    // Every handler ends in its own indirect jump, so the branch predictor learns which
+    // opcode tends to follow which instead of sharing one jump between all of them
+    static const void* const handlers[] = {
+        &&handler_OP_LOAD_CONSTANT,
+        &&handler_OP_LOAD_VARIABLE,
+        &&handler_OP_STORE_VARIABLE,
+        &&handler_OP_ADD,
+        &&handler_OP_SUB,
+        &&handler_OP_MUL,
+        &&handler_OP_DIV,
+        &&handler_OP_POW,
+        &&handler_OP_MOD,
+        &&handler_OP_CALL1,
+        &&handler_OP_CALL2,
+        &&handler_OP_CALL3,
+        &&handler_OP_ADDK,
+        &&handler_OP_SUBK,
+        &&handler_OP_MULK,
+        &&handler_OP_DIVK,
+        &&handler_OP_POWK,
+        &&handler_OP_MODK,
+        &&handler_OP_KSUB,
+        &&handler_OP_KDIV,
+        &&handler_OP_MULADD,
+        &&handler_OP_SINCOS,
+        &&handler_OP_MAX,
+        &&handler_OP_MIN,
+        &&handler_OP_SATURATE,
+        &&handler_OP_CLAMP,
+        &&handler_OP_SIN,
+        &&handler_OP_COS,
+        &&handler_OP_TAN,
+        &&handler_OP_ASIN,
+        &&handler_OP_ACOS,
+        &&handler_OP_ATAN,
+        &&handler_OP_ATAN2,
+        &&handler_OP_COSH,
+        &&handler_OP_TANH,
+        &&handler_OP_ASINH,
+        &&handler_OP_ACOSH,
+        &&handler_OP_ATANH,
+        &&handler_OP_SQRT,
+        &&handler_OP_CBRT,
+        &&handler_OP_RSQRT,
+        &&handler_OP_ABS,
+        &&handler_OP_SIGN,
+        &&handler_OP_EXP,
+        &&handler_OP_EXP2,
+        &&handler_OP_EXP10,
+        &&handler_OP_LOG,
+        &&handler_OP_LOG2,
+        &&handler_OP_LOG10,
+        &&handler_OP_CEIL,
+        &&handler_OP_FLOOR,
+        &&handler_OP_ROUND,
+        &&handler_OP_FRACT,
+        &&handler_OP_END
+    };
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == OPCODE_COUNT, "A handler is missing");
+#define HANDLER(opcode) handler_##opcode:
+#define NEXT(steps) s += steps; goto *handlers[s->opcode]
+    goto *handlers[s->opcode];
+#else
+#define HANDLER(opcode) case opcode:
+#define NEXT(steps) s += steps; continue
+    for(;;) switch(s->opcode) {
+#endif
+
+    HANDLER(OP_LOAD_CONSTANT) r[s->dst] = k[s->a]; NEXT(1);
+    HANDLER(OP_LOAD_VARIABLE) r[s->dst] = v[s->a]; NEXT(1);
+    HANDLER(OP_STORE_VARIABLE) v[s->b] = r[s->a]; NEXT(1);
+    HANDLER(OP_ADD) r[s->dst] = r[s->a] + r[s->b]; NEXT(1);
+    HANDLER(OP_SUB) r[s->dst] = r[s->a] - r[s->b]; NEXT(1);
+    HANDLER(OP_MUL) r[s->dst] = r[s->a] * r[s->b]; NEXT(1);
+    HANDLER(OP_DIV) r[s->dst] = r[s->a] / r[s->b]; NEXT(1);
+    HANDLER(OP_POW) r[s->dst] = pow(r[s->a], r[s->b]); NEXT(1);
+    HANDLER(OP_MOD) r[s->dst] = fmod(r[s->a], r[s->b]); NEXT(1);
+    HANDLER(OP_CALL1) r[s->dst] = Functions::get(s->b).f1(r[s->a]); NEXT(1);
+    HANDLER(OP_CALL2) r[s->dst] = Functions::get(s[1].b).f2(r[s->a], r[s->b]); NEXT(2);
+    HANDLER(OP_CALL3) r[s->dst] = Functions::get(s[1].b).f3(r[s->a], r[s->b], r[s[1].a]); NEXT(2);
+    HANDLER(OP_ADDK) r[s->dst] = r[s->a] + k[s->b]; NEXT(1);
+    HANDLER(OP_SUBK) r[s->dst] = r[s->a] - k[s->b]; NEXT(1);
+    HANDLER(OP_MULK) r[s->dst] = r[s->a] * k[s->b]; NEXT(1);
+    HANDLER(OP_DIVK) r[s->dst] = r[s->a] / k[s->b]; NEXT(1);
+    HANDLER(OP_POWK) r[s->dst] = pow(r[s->a], k[s->b]); NEXT(1);
+    HANDLER(OP_MODK) r[s->dst] = fmod(r[s->a], k[s->b]); NEXT(1);
+    HANDLER(OP_KSUB) r[s->dst] = k[s->b] - r[s->a]; NEXT(1);
+    HANDLER(OP_KDIV) r[s->dst] = k[s->b] / r[s->a]; NEXT(1);
+    HANDLER(OP_MULADD) r[s->dst] = Instruction::multiplyAdd(r[s->a], r[s->b], r[s[1].a]); NEXT(2);
+    HANDLER(OP_SINCOS) Functions::sinCos(r[s->a], r[s->dst], r[s->b]); NEXT(1);
+    HANDLER(OP_MAX) r[s->dst] = Builtins::max(r[s->a], r[s->b]); NEXT(1);
+    HANDLER(OP_MIN) r[s->dst] = Builtins::min(r[s->a], r[s->b]); NEXT(1);
+    HANDLER(OP_SATURATE) r[s->dst] = Builtins::saturate(r[s->a]); NEXT(1);
+    HANDLER(OP_CLAMP) r[s->dst] = Builtins::clamp(r[s->a], r[s->b], r[s[1].a]); NEXT(2);
+    HANDLER(OP_SIN) r[s->dst] = Builtins::sin(r[s->a]); NEXT(1);
+    HANDLER(OP_COS) r[s->dst] = Builtins::cos(r[s->a]); NEXT(1);
+    HANDLER(OP_TAN) r[s->dst] = Builtins::tan(r[s->a]); NEXT(1);
+    HANDLER(OP_ASIN) r[s->dst] = Builtins::asin(r[s->a]); NEXT(1);
+    HANDLER(OP_ACOS) r[s->dst] = Builtins::acos(r[s->a]); NEXT(1);
+    HANDLER(OP_ATAN) r[s->dst] = Builtins::atan(r[s->a]); NEXT(1);
+    HANDLER(OP_ATAN2) r[s->dst] = Builtins::atan2(r[s->a], r[s->b]); NEXT(1);
+    HANDLER(OP_COSH) r[s->dst] = Builtins::cosh(r[s->a]); NEXT(1);
+    HANDLER(OP_TANH) r[s->dst] = Builtins::tanh(r[s->a]); NEXT(1);
+    HANDLER(OP_ASINH) r[s->dst] = Builtins::asinh(r[s->a]); NEXT(1);
+    HANDLER(OP_ACOSH) r[s->dst] = Builtins::acosh(r[s->a]); NEXT(1);
+    HANDLER(OP_ATANH) r[s->dst] = Builtins::atanh(r[s->a]); NEXT(1);
+    HANDLER(OP_SQRT) r[s->dst] = Builtins::sqrt(r[s->a]); NEXT(1);
+    HANDLER(OP_CBRT) r[s->dst] = Builtins::cbrt(r[s->a]); NEXT(1);
+    HANDLER(OP_RSQRT) r[s->dst] = Builtins::rsqrt(r[s->a]); NEXT(1);
+    HANDLER(OP_ABS) r[s->dst] = Builtins::abs(r[s->a]); NEXT(1);
+    HANDLER(OP_SIGN) r[s->dst] = Builtins::sign(r[s->a]); NEXT(1);
+    HANDLER(OP_EXP) r[s->dst] = Builtins::exp(r[s->a]); NEXT(1);
+    HANDLER(OP_EXP2) r[s->dst] = Builtins::exp2(r[s->a]); NEXT(1);
+    HANDLER(OP_EXP10) r[s->dst] = Builtins::exp10(r[s->a]); NEXT(1);
+    HANDLER(OP_LOG) r[s->dst] = Builtins::log(r[s->a]); NEXT(1);
+    HANDLER(OP_LOG2) r[s->dst] = Builtins::log2(r[s->a]); NEXT(1);
+    HANDLER(OP_LOG10) r[s->dst] = Builtins::log10(r[s->a]); NEXT(1);
+    HANDLER(OP_CEIL) r[s->dst] = Builtins::ceil(r[s->a]); NEXT(1);
+    HANDLER(OP_FLOOR) r[s->dst] = Builtins::floor(r[s->a]); NEXT(1);
+    HANDLER(OP_ROUND) r[s->dst] = Builtins::round(r[s->a]); NEXT(1);
+    HANDLER(OP_FRACT) r[s->dst] = Builtins::fract(r[s->a]); NEXT(1);
+    HANDLER(OP_END) return;
+
+#if !defined(ADVANCEDCALC_COMPUTED_GOTO)
+    }
+#endif
+#undef HANDLER
+#undef NEXT
+}
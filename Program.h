@@ -0,0 +1,162 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+#include "Instruction.h"
+
+class Arena;
+
+// Labels as values are a GNU extension, other compilers dispatch with a switch
+#if defined(__GNUC__)
+#define ADVANCEDCALC_COMPUTED_GOTO
+#endif
+
+// A verified program in the form that is kept around and executed: 8 byte steps, a pool
+// of the constants they use and a table of the variables they touch, all in one
+// allocation so a program is copied, compared and hashed as a flat block of words.
+// Executing a program never modifies it, so one program can run on any number of threads
+// at once as long as each has its own registers and variables (see ExecutionContext).
+//
+// Calls to builtins are resolved to an opcode of their own so InstructionVM calls them
+// directly, and the steps end with OP_END so the dispatch loop needs no bounds check.
+class Program {
+    public:
+    enum Opcode {
+        OP_LOAD_CONSTANT = 0,   // r[dst] = k[a]
+        OP_LOAD_VARIABLE,       // r[dst] = variables[a]
+        OP_STORE_VARIABLE,      // variables[b] = r[a]
+        OP_ADD,                 // r[dst] = r[a] + r[b]
+        OP_SUB,
+        OP_MUL,
+        OP_DIV,
+        OP_POW,
+        OP_MOD,
+        OP_CALL1,               // Builtins without an opcode, r[dst] = function b(r[a])
+        OP_CALL2,               // Extended, function is in the extension's b
+        OP_CALL3,               // Extended
+        OP_ADDK,                // r[dst] = r[a] + k[b]
+        OP_SUBK,
+        OP_MULK,
+        OP_DIVK,
+        OP_POWK,
+        OP_MODK,
+        OP_KSUB,                // r[dst] = k[b] - r[a]
+        OP_KDIV,
+        OP_MULADD,              // Extended, r[dst] = r[a] * r[b] + r[c]
+        OP_SINCOS,              // r[dst] = sin(r[a]), r[b] = cos(r[a])
+
+        // One per builtin, pow() is OP_POW
+        OP_MAX,
+        OP_MIN,
+        OP_SATURATE,
+        OP_CLAMP,               // Extended
+        OP_SIN,
+        OP_COS,
+        OP_TAN,
+        OP_ASIN,
+        OP_ACOS,
+        OP_ATAN,
+        OP_ATAN2,
+        OP_COSH,
+        OP_TANH,
+        OP_ASINH,
+        OP_ACOSH,
+        OP_ATANH,
+        OP_SQRT,
+        OP_CBRT,
+        OP_RSQRT,
+        OP_ABS,
+        OP_SIGN,
+        OP_EXP,
+        OP_EXP2,
+        OP_EXP10,
+        OP_LOG,
+        OP_LOG2,
+        OP_LOG10,
+        OP_CEIL,
+        OP_FLOOR,
+        OP_ROUND,
+        OP_FRACT,
+
+        OP_END,
+        OPCODE_COUNT
+    };
+
+    // Operations with a third source or a call without an opcode are followed by one
+    // extension step, not executed, whose a holds the third source and b the function
+    struct Step {
+        uint16_t opcode;
+        uint16_t dst;
+        uint16_t a;
+        uint16_t b;
+    };
+    static_assert(sizeof(Step) == 8, "Steps are packed into one word");
+
+    struct Symbol {
+        uint16_t slot;
+        uint16_t length;
+        uint32_t offset;        // Into the names following the symbols
+    };
+
+    // Largest register, slot, constant or function index a step can hold
+    static const int maxIndex = UINT16_MAX;
+
+    // An empty program, executing it does nothing
+    Program();
+
+    static bool isExtended(int opcode);
+
+    // Replaces the program with verified instructions, reusing the allocation. Returns
+    // nullptr, or why the program doesn't fit in 16 bit fields, in which case it is cleared.
+    const char* assign(const std::vector<Instruction>& instructions, int registerCount, int resultRegister,
+        std::span<const std::string> variableNames, Arena& arena);
+    void clear();
+
+    const Step* getSteps() const;
+    const double* getConstants() const;
+    const Symbol* getSymbols() const;
+    std::string_view getSymbolName(const Symbol& symbol) const;
+
+    // Steps including extensions, OP_END is not counted
+    size_t size() const;
+    size_t getConstantCount() const;
+    size_t getSymbolCount() const;
+    int getRegisterCount() const;
+    int getResultRegister() const;
+    // One more than the highest variable slot the program touches
+    int getVariableCount() const;
+    // Slot of a variable the program touches, -1 if it doesn't
+    int findSlot(std::string_view name) const;
+
+    // registers must hold getRegisterCount() values and variables getVariableCount()
+    void execute(double* registers, double* variables) const;
+
+    // Size of the single allocation holding the program
+    size_t getByteSize() const;
+    uint64_t hash() const;
+    bool operator==(const Program& other) const;
+
+    private:
+    struct Header {
+        uint32_t stepCount;     // Including OP_END
+        uint32_t constantCount;
+        uint32_t symbolCount;
+        uint32_t nameBytes;
+        int32_t registerCount;
+        int32_t resultRegister;
+        uint32_t variableCount;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(Header) % sizeof(uint64_t) == 0, "Sections stay word aligned");
+
+    const Header& header() const {
+        return *reinterpret_cast<const Header*>(words.data());
+    }
+
+    // Header, constants, steps, symbols then names, each section word aligned
+    std::vector<uint64_t> words;
+};
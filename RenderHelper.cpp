@@ -0,0 +1,48 @@
+#include "RenderHelper.h"
+#include "Token.h"
+
+#include <map>
+
+glm::mat4 RenderHelper::quadMat(float x, float y, float w, float h) {
+    glm::mat4 mat = glm::mat4(1.0f);
+    mat = glm::translate(mat, glm::vec3(x, y, 0.0f));
+    mat = glm::scale(mat, glm::vec3(w, h, 1.0f));
+    return mat;
+}
+
+glm::vec4 RenderHelper::tokenColor(const Token& token, std::string_view source) {
+    glm::vec3 num = glm::vec3(0., 255., 188) / glm::vec3(256.);
+    glm::vec3 identifer = glm::vec3(251, 243, 0) / glm::vec3(256.);
+    glm::vec3 unresolved = glm::vec3(241, 170, 18) / glm::vec3(256.);
+    glm::vec3 constant = glm::vec3(174, 241, 18) / glm::vec3(256.);
+
+    glm::vec3 oper = glm::vec3(184, 184, 184) / glm::vec3(256.);
+    glm::vec3 parenths = glm::vec3(160, 160, 160) / glm::vec3(256.);
+
+    const std::map<int, glm::vec3> tokenColours = {
+        {Token::TOKEN_NUMBER, num},
+        {Token::TOKEN_OPERATOR, oper},
+        {Token::TOKEN_EXPRESSION, oper},
+        {Token::TOKEN_WHITESPACE, glm::vec3(1., 1., 1.)},
+        {Token::TOKEN_OPEN_PARENTHESIS, parenths},
+        {Token::TOKEN_CLOSE_PARENTHESIS, parenths},
+        {Token::TOKEN_COMMA, parenths},
+        {Token::TOKEN_IDENTIFIER, identifer},
+        {Token::TOKEN_SEMICOLON, parenths},
+        {Token::TOKEN_FUNCTION, identifer},
+        {Token::TOKEN_NULL, glm::vec3(1., 1., 1.)},
+        {Token::TOKEN_UNKNOWN, glm::vec3(.5)},
+    };
+
+    glm::vec3 color = tokenColours.at(token.getType());
+
+    if(token.isType(Token::TOKEN_IDENTIFIER)) {
+        if(!token.isResolved(source)) {
+            color = unresolved;
+        } else if (token.isConstantIdentifier(source)) {
+            color = constant;
+        }
+    }
+
+    return glm::vec4(color, 1.);
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <string_view>
+
+class Token;
+
+class RenderHelper {
+    public:
+    static glm::mat4 quadMat(float x, float y, float w, float h);
+    // source is the text the token indexes into
+    static glm::vec4 tokenColor(const Token& token, std::string_view source);
+};
@@ -0,0 +1,1482 @@
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <math.h>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+
+#include "Calculator.h"
+#include "Instruction.h"
+#include "InstructionVM.h"
+#include "JitProgram.h"
+#include "Parser.h"
+#include "Token.h"
+#include "TokenList.h"
+#include "Helper.h"
+#include "Verifier.h"
+#include "Program.h"
+#include "ExecutionContext.h"
+#include "ThreadPool.h"
+#include "GraphSampler.h"
+#include "IntervalContext.h"
+#include "TripleBuffer.h"
+#include "EvaluationWorker.h"
+#include "Functions.h"
+#include "Arena.h"
+
+// Counts global heap allocations, for checking the steady state compile path makes none
+static size_t heapAllocations = 0;
+
+void* operator new(size_t size) {
+    heapAllocations++;
+    if(void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+int runExpressionTests() {
+    auto calculator = std::make_shared<Calculator>(false);
+
+    const std::vector<std::pair<std::string, double>> testCases = {
+        {"1+1", 2},
+        {"1.5 + 1.5", 3},
+        {"1.5 + -1.5", 0},
+        {"-1 + -2 + (-1 * 2)", -5.0},
+        {"0x0A + 10", 20},
+        {"0xFF + -0x0F", 240},
+        {"33-9+40-(30+15)", 19},
+        {"TAU + PI + (-PI + -TAU)", 0.},
+        {"max(1, max(1, 2))", 2.},
+        {"((1+1))", 2.},
+        {"+pi", M_PI},
+        {"-pi - -pi", 0},
+        {"sign(-pi)", -1},
+        {"pow(2, 3)", 8},
+        {"atan2(1, 0)", M_PI / 2},
+        {"clamp(5, 0, 1) + sqrt(16)", 5},
+        {"a=2; a*3", 6},
+        {"a=1+2; a", 3},
+        {"a=b=2; a+b", 4},
+        {"-2^2", 4},
+        {"x=3; -x^2", -9},
+        {"x=3; -x*x", -9},
+        {"x=3; 2*-x^2", -18},
+        {"x=3; 2^-x", 0.125},
+        {"-(2)^2", -4},
+        {"- 2^2", -4},
+        {"1 - -2^2", -3},
+        {"2^-1", 0.5},
+        {"2^3^2", 64},
+        {"1+-2", -1},
+        {"-(1+2)*2", -6},
+        {"a=3; -a + 2*-a", -9},
+        {"max(1, max(1, max(2, -1)))", 2},
+    };
+
+    int failures = 0;
+    for(auto &i : testCases) {
+        calculator->compileInput(i.first);
+        double result = calculator->executeInstructions();
+
+        if(result != i.second || !calculator->resultIsValid()) {
+            std::cout << "Test case failed: '" << i.first << "', expected: " << i.second << ", got: " << result << std::endl;
+            calculator->setDebug(true);
+            calculator->compileInput(i.first);
+            calculator->setDebug(false);
+            failures++;
+        }
+    }
+    std::cout << "Expression tests passed " << testCases.size() - failures << "/" << testCases.size() << std::endl;
+    return failures;
+}
+
+int runTokenizerTests() {
+    Parser parser(nullptr);
+    TokenList tokens;
+    int failures = 0;
+
+    // Reused list, the second parse must not see anything of the first
+    parser.parseInput("sin(x) * 12345678", tokens);
+    parser.parseInput("max(0x1F, 2.5)+pi", tokens);
+
+    const std::vector<std::pair<std::string, int>> expected = {
+        {"max", Token::TOKEN_IDENTIFIER},
+        {"(", Token::TOKEN_OPEN_PARENTHESIS},
+        {"0x1F", Token::TOKEN_NUMBER},
+        {",", Token::TOKEN_COMMA},
+        {" ", Token::TOKEN_WHITESPACE},
+        {"2.5", Token::TOKEN_NUMBER},
+        {")", Token::TOKEN_CLOSE_PARENTHESIS},
+        {"+", Token::TOKEN_OPERATOR},
+        {"pi", Token::TOKEN_IDENTIFIER},
+    };
+
+    if(tokens.list.size() != expected.size()) {
+        std::cout << "Tokenizer test failed: expected " << expected.size() << " tokens, got " << tokens.list.size() << std::endl;
+        return 1;
+    }
+    for(int i = 0; i < expected.size(); ++i) {
+        if(tokens.getValue(tokens.list[i]) != expected[i].first || !tokens.list[i].isType(expected[i].second)) {
+            std::cout << "Tokenizer test failed: token " << i << " is '" << tokens.getValue(tokens.list[i]) << "'" << std::endl;
+            failures++;
+        }
+    }
+    if(tokens.list[2].getNumber() != 31. || tokens.list[5].getNumber() != 2.5) {
+        std::cout << "Tokenizer test failed: literals were not pre-parsed" << std::endl;
+        failures++;
+    }
+
+    parser.parseInput("1.2.3", tokens);
+    if(tokens.list.size() != 1 || !std::isnan(tokens.list[0].getNumber())) {
+        std::cout << "Tokenizer test failed: malformed literal was accepted" << std::endl;
+        failures++;
+    }
+
+    // Runs that end on either side of the 16 and 32 byte vector widths, followed by a
+    // byte outside the run so the scanner has to stop inside a block
+    for(int length = 1; length <= 70; ++length) {
+        std::string name(length, 'a');
+        for(int i = 0; i < length; ++i) {
+            name[i] = "abcXYZ019"[i % 9];
+        }
+        std::string number(length, '7');
+        number[length / 2] = '.';
+        parser.parseInput(name + "+" + number + "\xC3(", tokens);
+
+        if(tokens.list.size() != 5 || !tokens.list[0].isType(Token::TOKEN_IDENTIFIER) || tokens.list[0].getLength() != length
+            || !tokens.list[2].isType(Token::TOKEN_NUMBER) || tokens.list[2].getLength() != length
+            || !tokens.list[3].isType(Token::TOKEN_UNKNOWN) || !tokens.list[4].isType(Token::TOKEN_OPEN_PARENTHESIS)) {
+            std::cout << "Tokenizer test failed: runs of length " << length << " were split wrong" << std::endl;
+            failures++;
+        }
+    }
+
+    if(Parser::getPrecedence('^') != 3 || Parser::getPrecedence('=') != 0 || Parser::getPrecedence('a') != -1 || Parser::getPrecedence('\xFF') != -1) {
+        std::cout << "Tokenizer test failed: operator precedence table is wrong" << std::endl;
+        failures++;
+    }
+
+    std::cout << "Tokenizer tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+int runLiteralTests() {
+    int failures = 0;
+
+    // Literals are correctly rounded and anything left over makes them invalid
+    const std::vector<std::pair<std::string, double>> literals = {
+        {"0.1", 0.1},
+        {".5", 0.5},
+        {"5.", 5.},
+        {"3.141592653589793238", M_PI},
+        {"0x10", 16.},
+        {"0XfF", 255.},
+        {"0x1FFFFFFFFFFFFF", 9007199254740991.},
+        {"0x1.8", 1.5},
+        {"00012", 12.},
+        {"1e5", 100000.},
+    };
+    for(auto &i : literals) {
+        if(Parser::parseNumber(i.first) != i.second) {
+            std::cout << "Literal test failed: " << i.first << " parsed as " << Parser::parseNumber(i.first) << std::endl;
+            failures++;
+        }
+    }
+    for(auto &i : {"0x", "1.2.3", "0x1.2.3", "1x2", "0xG", ""}) {
+        if(!std::isnan(Parser::parseNumber(i))) {
+            std::cout << "Literal test failed: " << i << " was accepted" << std::endl;
+            failures++;
+        }
+    }
+
+    // Display round trips without printing noise digits
+    for(double value : {0.1, 1. / 3., M_PI, 1e300, -2.5, 42., 0.1 + 0.2}) {
+        std::string text = Helper::toShortestString(value);
+        if(std::strtod(text.c_str(), nullptr) != value) {
+            std::cout << "Literal test failed: " << value << " printed as " << text << std::endl;
+            failures++;
+        }
+    }
+    if(Helper::toShortestString(0.1) != "0.1" || Helper::toShortestString(42.) != "42" || Helper::toShortestString(0.1 + 0.2) != "0.30000000000000004") {
+        std::cout << "Literal test failed: display is not the shortest round trip" << std::endl;
+        failures++;
+    }
+
+    // Constants are substituted as the exact double, not a printed approximation
+    Calculator calculator(false);
+    calculator.compileInput("pi");
+    if(calculator.executeInstructions() != M_PI) {
+        std::cout << "Literal test failed: pi is not exact" << std::endl;
+        failures++;
+    }
+
+    std::cout << "Literal tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+int runErrorTests() {
+    // The compiler is the only validation pass, it has to catch what evaluation used to
+    const std::vector<std::pair<std::string, bool>> testCases = {
+        {"1+", false},
+        {"(1+2", false},
+        {"1+2)", false},
+        {"max(1)", false},
+        {"max(1, 2, 3)", false},
+        {"max(1, )", false},
+        {"foo(2)", false},
+        {"1/0", false},
+        {"a=2; 3=a", false},
+        {";", false},
+        {"1/x", true},
+        {"x % 0.7", true},
+        {"a=2; a*3", true},
+    };
+
+    int failures = 0;
+    Calculator calculator(false);
+    for(auto &i : testCases) {
+        calculator.compileInput(i.first);
+        bool valid = calculator.resultIsValid() && calculator.getErrors().empty();
+        if(valid != i.second) {
+            std::cout << "Error test failed: '" << i.first << "' should be " << (i.second ? "valid" : "invalid") << std::endl;
+            failures++;
+        }
+        // A cache hit must report the same result
+        calculator.compileInput(i.first);
+        if(calculator.resultIsValid() != valid) {
+            std::cout << "Error test failed: '" << i.first << "' changed validity on recompilation" << std::endl;
+            failures++;
+        }
+    }
+
+    // Editing one line of a cached program
+    calculator.compileInput("a=3; a*x");
+    calculator.compileInput("a=3; a*x+1");
+    calculator.vm->setVar("x", 2.);
+    if(calculator.executeInstructions() != 7. || !calculator.resultIsValid()) {
+        std::cout << "Error test failed: edited program gave " << calculator.executeInstructions() << std::endl;
+        failures++;
+    }
+
+    // No result is reported by the compile, executing it again adds nothing
+    calculator.compileInput(";");
+    for(int i = 0; i < 3; ++i) {
+        calculator.executeInstructions();
+    }
+    if(calculator.getErrors().size() != 1) {
+        std::cout << "Error test failed: " << calculator.getErrors().size() << " errors after executing a program with no result" << std::endl;
+        failures++;
+    }
+
+    std::cout << "Error tests passed " << testCases.size() + 2 - failures << "/" << testCases.size() + 2 << std::endl;
+    return failures;
+}
+
+int runDeepNestingTests() {
+    int failures = 0;
+    const int depth = 100000;
+
+    // Parenthesization, negation and calls nested far deeper than any recursive parser allows
+    const std::vector<std::pair<std::string, double>> testCases = {
+        {std::string(depth, '(') + "x+1" + std::string(depth, ')'), 3},
+        {std::string(depth, '-') + "x", 2},
+        {[&]() {
+            std::string nested = "x";
+            for(int i = 0; i < depth / 10; ++i) {
+                nested = "max(" + nested + ", 1)";
+            }
+            return nested;
+        }(), 2},
+    };
+
+    for(auto &i : testCases) {
+        Calculator calculator(false);
+        calculator.compileInput(i.first);
+        calculator.vm->setVar("x", 2.);
+        double result = calculator.executeInstructions();
+        if(result != i.second || !calculator.resultIsValid()) {
+            std::cout << "Deep nesting test failed: '" << i.first.substr(0, 32) << "...', expected: " << i.second << ", got: " << result << std::endl;
+            failures++;
+        }
+    }
+    std::cout << "Deep nesting tests passed " << testCases.size() - failures << "/" << testCases.size() << std::endl;
+    return failures;
+}
+
+int runAllocationTests() {
+    // Different inputs each time so nothing is served from the compile cache
+    const std::vector<std::string> inputs = {
+        "sin(x)*cos(x) + sqrt(abs(x))",
+        "a=2; b=(a*3); max(b*x, 1)",
+        "x*2+1",
+        "(x+1)*(x-1)/(x*x+1) + clamp(x, -0.25, 0.25)",
+        "sin(x)^2 + sin(x)*cos(x) + 2*PI*x",
+    };
+
+    Calculator calculator(false);
+    auto run = [&]() {
+        double sum = 0.;
+        for(auto &input : inputs) {
+            calculator.compileInput(input);
+            // Slots are per compilation, rebinding a name the input used doesn't allocate
+            calculator.vm->setVar(calculator.vm->bind("x"), 0.5);
+            sum += calculator.executeInstructions();
+        }
+        return sum;
+    };
+
+    // Grows the arena, caches and vectors to their working size
+    double expected = run();
+    run();
+
+    // Invalid inputs are most of what is compiled while typing, errors must not allocate either
+    const std::vector<std::string> invalidInputs = {
+        "sin(x",
+        "max(1, )",
+        "2 + * 3",
+        "foo(x) + (1",
+    };
+    auto runInvalid = [&]() {
+        size_t errorCount = 0;
+        for(auto &input : invalidInputs) {
+            calculator.compileInput(input);
+            errorCount += calculator.getErrors().size();
+        }
+        return errorCount;
+    };
+    runInvalid();
+    runInvalid();
+
+    size_t before = heapAllocations;
+    double result = run();
+    size_t errorCount = runInvalid();
+    size_t allocations = heapAllocations - before;
+
+    if(allocations != 0 || result != expected || errorCount < invalidInputs.size()) {
+        std::cout << "Allocation test failed: " << allocations << " heap allocations in steady state" << std::endl;
+        return 1;
+    }
+
+    // A request that grows a little on every compilation must not add a block every time
+    Arena arena(1024);
+    const size_t cycles = 20000;
+    for(size_t i = 0; i < cycles; ++i) {
+        arena.reset();
+        arena.allocate(1024 + 8 * i, 8);
+        arena.allocate(16, 8);
+    }
+    size_t maxBlocks = 2 + (size_t)std::ceil(std::log2((1024. + 8. * cycles) / 1024.));
+    if(arena.getBlockCount() > maxBlocks) {
+        std::cout << "Allocation test failed: " << arena.getBlockCount() << " arena blocks for growing requests, expected at most " << maxBlocks << std::endl;
+        return 1;
+    }
+    std::cout << "Allocation tests passed" << std::endl;
+    return 0;
+}
+
+int runVariableSlotTests() {
+    Calculator calculator(false);
+    int failures = 0;
+
+    calculator.compileInput("x*2 + y");
+    auto xSlot = calculator.vm->bind("x");
+    auto ySlot = calculator.vm->bind("y");
+    if(xSlot == ySlot || calculator.vm->bind("x") != xSlot) {
+        std::cout << "Variable slot test failed: slots are not stable" << std::endl;
+        failures++;
+    }
+
+    calculator.vm->setVar(ySlot, 1.);
+    for(int i = 0; i < 4; ++i) {
+        calculator.vm->setVar(xSlot, i);
+        double result = calculator.executeInstructions();
+        if(result != i * 2 + 1) {
+            std::cout << "Variable slot test failed: x=" << i << ", expected: " << i * 2 + 1 << ", got: " << result << std::endl;
+            failures++;
+        }
+    }
+
+    if(calculator.vm->getVar("unbound") != 0. || calculator.vm->getVariableNames().size() != 2) {
+        std::cout << "Variable slot test failed: getVar created a slot" << std::endl;
+        failures++;
+    }
+
+    // Every prefix typed is a name once, only the current input's names keep slots
+    const int names = 70000;
+    for(int i = 0; i < names; ++i) {
+        calculator.compileInput("v" + std::to_string(i) + "+1");
+    }
+    if(calculator.vm->getVariableNames().size() != 1 || calculator.vm->getVariableNames()[0] != "v" + std::to_string(names - 1)) {
+        std::cout << "Variable slot test failed: " << calculator.vm->getVariableNames().size() << " names bound after " << names << " inputs" << std::endl;
+        failures++;
+    }
+    calculator.compileInput("1+1");
+    if(!calculator.resultIsValid() || calculator.executeInstructions() != 2. || calculator.vm->getVariableNames().size() != 0) {
+        std::cout << "Variable slot test failed: 1+1 didn't compile after " << names << " names" << std::endl;
+        failures++;
+    }
+
+    std::cout << "Variable slot tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+// Compiles expression with and without optimization and compares the results over a range of x
+bool optimizedMatchesUnoptimized(const std::string& expression, int& optimizedSize) {
+    Calculator reference(false);
+    reference.setOptimize(false);
+    reference.compileInput(expression);
+
+    Calculator optimized(false);
+    optimized.compileInput(expression);
+    optimizedSize = optimized.compiledInstructions.size();
+
+    auto referenceX = reference.vm->bind("x");
+    auto optimizedX = optimized.vm->bind("x");
+    for(double x = -2.; x <= 2.; x += 0.125) {
+        reference.vm->setVar(referenceX, x);
+        optimized.vm->setVar(optimizedX, x);
+        double expected = reference.executeInstructions();
+        double result = optimized.executeInstructions();
+        if(result != expected && !(isnan(result) && isnan(expected))) {
+            std::cout << "Optimizer test failed: '" << expression << "' at x=" << x << ", expected: " << expected << ", got: " << result << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int runOptimizerTests() {
+    // Expression and the number of instructions expected after optimization
+    const std::vector<std::pair<std::string, int>> testCases = {
+        {"2*PI*x", 2},
+        {"sin(PI/4)", 1},
+        {"x*1 + 0", 1},
+        {"1*x^1 - 0", 1},
+        {"x/1 + max(2, 3)*x", 3},
+        {"a=2; b=(a*3); b*x", 6},
+        {"clamp(x, -1+0.5, 2^2)", 4},
+        {"x*0", 2},
+        {"sin(x)^2 + sin(x)*cos(x)", 4},
+        {"(x+1)*(x+1)", 3},
+        {"x*2 + 2*x", 3},
+        {"a=x; a=(a+1); a*a", 5},
+    };
+
+    int failures = 0;
+    for(auto &i : testCases) {
+        int optimizedSize = 0;
+        if(!optimizedMatchesUnoptimized(i.first, optimizedSize)) {
+            failures++;
+        } else if(optimizedSize != i.second) {
+            std::cout << "Optimizer test failed: '" << i.first << "', expected " << i.second << " instructions, got: " << optimizedSize << std::endl;
+            failures++;
+        }
+    }
+    std::cout << "Optimizer tests passed " << testCases.size() - failures << "/" << testCases.size() << std::endl;
+    return failures;
+}
+
+// Distance in units in the last place, equal values (including +0/-0) and NaNs are 0 apart
+int64_t ulpDistance(double a, double b) {
+    if(a == b || (isnan(a) && isnan(b))) {
+        return 0;
+    }
+    if(isnan(a) || isnan(b)) {
+        return INT64_MAX;
+    }
+    int64_t ia, ib;
+    std::memcpy(&ia, &a, sizeof(a));
+    std::memcpy(&ib, &b, sizeof(b));
+    if(ia < 0) ia = INT64_MIN - ia;
+    if(ib < 0) ib = INT64_MIN - ib;
+    return ia > ib ? ia - ib : ib - ia;
+}
+
+int runPeepholeTests() {
+    struct PeepholeCase {
+        std::string expression;
+        // Evaluated unoptimized as the reference
+        std::string reference;
+        int64_t maxUlp;
+        int expectedOperation;
+    };
+
+#ifdef FP_FAST_FMA
+    const int64_t fmaUlp = 1;
+#else
+    const int64_t fmaUlp = 0;
+#endif
+
+    const std::vector<PeepholeCase> testCases = {
+        {"x^2", "x^2", 0, Instruction::OP_MUL},
+        {"x^3", "x^3", 2, Instruction::OP_MUL},
+        {"x^0.5", "x^0.5", 0, Instruction::OP_CALL1},
+        {"x^1.7", "x^1.7", 0, Instruction::OP_POWK},
+        {"x + 2", "x + 2", 0, Instruction::OP_ADDK},
+        {"2 + x", "2 + x", 0, Instruction::OP_ADDK},
+        {"x - 2", "x - 2", 0, Instruction::OP_SUBK},
+        {"2 - x", "2 - x", 0, Instruction::OP_KSUB},
+        {"x * 3", "x * 3", 0, Instruction::OP_MULK},
+        {"x / 3", "x / 3", 0, Instruction::OP_DIVK},
+        {"3 / (x+8.5)", "3 / (x+8.5)", 0, Instruction::OP_KDIV},
+        {"x % 1.75", "x % 1.75", 0, Instruction::OP_MODK},
+        {"x*(x+1) + x", "x*(x+1) + x", fmaUlp, Instruction::OP_MULADD},
+        {"sin(x) + cos(x)", "sin(x) + cos(x)", 0, Instruction::OP_SINCOS},
+        {"cos(x*2) * sin(x*2)", "cos(x*2) * sin(x*2)", 0, Instruction::OP_SINCOS},
+        {"rsqrt(x)", "x^(0-0.5)", 1, Instruction::OP_CALL1},
+        {"exp10(x)", "10^x", 2, Instruction::OP_CALL1},
+    };
+
+    int failures = 0;
+    for(auto &i : testCases) {
+        Calculator reference(false);
+        reference.setOptimize(false);
+        reference.compileInput(i.reference);
+
+        Calculator optimized(false);
+        optimized.compileInput(i.expression);
+
+        bool found = false;
+        for(auto &instruction : optimized.compiledInstructions) {
+            found = found || instruction.getOperation() == i.expectedOperation;
+        }
+        if(!found) {
+            std::cout << "Peephole test failed: '" << i.expression << "' was not rewritten" << std::endl;
+            failures++;
+            continue;
+        }
+
+        auto referenceX = reference.vm->bind("x");
+        auto optimizedX = optimized.vm->bind("x");
+        for(double x = -4.; x <= 4.; x += 1. / 64.) {
+            reference.vm->setVar(referenceX, x);
+            optimized.vm->setVar(optimizedX, x);
+            double expected = reference.executeInstructions();
+            double result = optimized.executeInstructions();
+            if(ulpDistance(expected, result) > i.maxUlp) {
+                std::cout << "Peephole test failed: '" << i.expression << "' at x=" << x << ", expected: " << expected << ", got: " << result << std::endl;
+                failures++;
+                break;
+            }
+        }
+    }
+    std::cout << "Peephole tests passed " << testCases.size() - failures << "/" << testCases.size() << std::endl;
+    return failures;
+}
+
+int runVerifierTests() {
+    int failures = 0;
+    Arena arena;
+    const int sinId = Functions::find("sin");
+    const int maxId = Functions::find("max");
+
+    struct VerifierCase {
+        std::string name;
+        std::vector<Instruction> instructions;
+        int resultRegister;
+        bool valid;
+    };
+    const std::vector<VerifierCase> testCases = {
+        {"valid", {Instruction(Instruction::OP_LOAD_VARIABLE, 0, 0), Instruction(Instruction::OP_MULK, 1, 0, 0, 0, Operand(Operand::TYPE_NUMBER, 2.))}, 1, true},
+        {"read before write", {Instruction(Instruction::OP_ADD, 1, 0, 0), Instruction(Instruction::OP_LOAD_VARIABLE, 0, 0)}, 1, false},
+        {"register out of range", {Instruction(Instruction::OP_LOAD_VARIABLE, 2, 0)}, 2, false},
+        {"variable out of range", {Instruction(Instruction::OP_LOAD_VARIABLE, 0, 1)}, 0, false},
+        {"store out of range", {Instruction(Instruction::OP_LOAD_VARIABLE, 0, 0), Instruction(Instruction::OP_STORE_VARIABLE, -1, 0, 5)}, 0, false},
+        {"arity", {Instruction(Instruction::OP_LOAD_VARIABLE, 0, 0), Instruction(Instruction::OP_CALL2, 1, 0, 0, 0, Operand(Operand::TYPE_FUNCTION, sinId))}, 1, false},
+        {"call", {Instruction(Instruction::OP_LOAD_VARIABLE, 0, 0), Instruction(Instruction::OP_CALL2, 1, 0, 0, 0, Operand(Operand::TYPE_FUNCTION, maxId))}, 1, true},
+        {"unknown function", {Instruction(Instruction::OP_LOAD_VARIABLE, 0, 0), Instruction(Instruction::OP_CALL1, 1, 0, 0, 0, Operand(Operand::TYPE_FUNCTION, 100000))}, 1, false},
+        {"unknown operation", {Instruction(Instruction::OP_COUNT, 0, 0)}, 0, false},
+        {"undefined result", {Instruction(Instruction::OP_LOAD_VARIABLE, 0, 0)}, 1, false},
+    };
+    for(auto &i : testCases) {
+        bool valid = Verifier::verify(i.instructions, 2, i.resultRegister, 1, arena) == nullptr;
+        if(valid != i.valid) {
+            std::cout << "Verifier test failed: " << i.name << (i.valid ? " was rejected" : " was accepted") << std::endl;
+            failures++;
+        }
+    }
+
+    // A long sum only ever has a few values live, compaction reuses the rest
+    std::string sum = "x";
+    for(int i = 1; i < 200; ++i) {
+        sum += " + x*" + std::to_string(i);
+    }
+    for(bool optimize : {false, true}) {
+        Calculator calculator(false);
+        calculator.setOptimize(optimize);
+        calculator.compileInput(sum);
+        calculator.vm->setVar("x", 0.5);
+        double expected = 0.5;
+        for(int i = 1; i < 200; ++i) {
+            expected += 0.5 * i;
+        }
+        if(calculator.registerCount > 4 || calculator.executeInstructions() != expected) {
+            std::cout << "Verifier test failed: " << calculator.registerCount << " registers for a sum" << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << "Verifier tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+int runBatchTests() {
+    const std::vector<std::string> testCases = {
+        "x*2+1",
+        "sin(x)^2 + sin(x)*cos(x) + sqrt(abs(x))",
+        "max(x, min(x*x, 0.5)) - clamp(x, -0.25, 0.25) + 3/(x+8.5) - 2 + x^1.3 % 1.7",
+        "scale=.5; v=(sin(x*pi*40) * scale); v2=sin(x*pi*.3); clamp(v+v2,-.25,.25)-v2+(x*1.2)",
+        "x*y + y",
+        "y*3 + 1",
+        "y=x*2; y+1",
+    };
+
+    int failures = 0;
+    for(auto &expression : testCases) {
+        Calculator calculator(false);
+        calculator.compileInput(expression);
+        calculator.vm->setVar("y", 0.25);
+        // -1 where the expression has no x, which the batch must not write through
+        int xSlot = -1;
+        auto names = calculator.vm->getVariableNames();
+        for(int i = 0; i < names.size(); ++i) {
+            if(names[i] == "x") {
+                xSlot = i;
+            }
+        }
+        std::vector<double> variables(names.size());
+        for(int i = 0; i < names.size(); ++i) {
+            variables[i] = calculator.vm->getVar(i);
+        }
+
+        // Not multiples of the block size so the padded last block is exercised, alone and after full ones
+        for(size_t count : {5, 8 * 13 + 5}) {
+            std::vector<double> inputs(count);
+            for(int i = 0; i < inputs.size(); ++i) {
+                inputs[i] = -2. + 4. * i / inputs.size();
+            }
+            std::vector<double> outputs(inputs.size());
+            calculator.executeBatch(xSlot, inputs.data(), outputs.data(), inputs.size());
+
+            // A batch leaves the VM's variables as they were, stores included
+            bool unchanged = true;
+            for(int i = 0; i < variables.size(); ++i) {
+                unchanged &= ulpDistance(calculator.vm->getVar(i), variables[i]) == 0;
+            }
+            if(!unchanged) {
+                std::cout << "Batch test failed: '" << expression << "' changed the VM's variables" << std::endl;
+                failures++;
+                break;
+            }
+
+            bool matches = true;
+            for(int i = 0; i < inputs.size() && matches; ++i) {
+                if(xSlot >= 0) {
+                    calculator.vm->setVar(xSlot, inputs[i]);
+                }
+                double expected = calculator.executeInstructions();
+                for(int v = 0; v < variables.size(); ++v) {
+                    calculator.vm->setVar(v, variables[v]);
+                }
+                if(ulpDistance(expected, outputs[i]) != 0) {
+                    std::cout << "Batch test failed: '" << expression << "' at x=" << inputs[i] << ", expected: " << expected << ", got: " << outputs[i] << std::endl;
+                    matches = false;
+                }
+            }
+            if(!matches) {
+                failures++;
+                break;
+            }
+        }
+    }
+    std::cout << "Batch tests passed " << testCases.size() - failures << "/" << testCases.size() << std::endl;
+    return failures;
+}
+
+int runThreadedTests() {
+    int failures = 0;
+    const double arguments[] = {0.3, 0.7};
+
+    // Every builtin has its own opcode and matches the reference interpreter exactly
+    for(auto &function : Functions::getFunctions()) {
+        std::string expression = function.name + "(x";
+        for(int a = 1; a < function.arity; ++a) {
+            expression += ", " + Helper::toShortestString(arguments[a - 1]);
+        }
+        expression += ")";
+
+        Calculator calculator(false);
+        calculator.setOptimize(false);
+        calculator.compileInput(expression);
+
+        for(int i = 0; i < calculator.getProgram()->size(); ++i) {
+            int opcode = calculator.getProgram()->getSteps()[i].opcode;
+            if(opcode >= Program::OP_CALL1 && opcode <= Program::OP_CALL3) {
+                std::cout << "Threaded test failed: " << function.name << " has no opcode" << std::endl;
+                failures++;
+            }
+        }
+
+        for(double x : {-2.5, -0.5, 0., 0.25, 0.9, 3.75}) {
+            calculator.vm->setVar("x", x);
+            double threaded = calculator.executeInstructions();
+            calculator.vm->execute(calculator.compiledInstructions);
+            double reference = calculator.vm->getRegister(calculator.resultRegister);
+            if(ulpDistance(threaded, reference) != 0) {
+                std::cout << "Threaded test failed: " << expression << " at " << x << " is " << threaded << ", expected " << reference << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    // Superinstructions and assignments through the optimizer
+    for(auto &expression : {"a=x*2; sin(a)^2 + cos(a)^2 + a", "clamp(x*3, -1, 1) + 2 - x + 7/x", "x % 1.75 + x^1.7 + rsqrt(x+4)"}) {
+        Calculator calculator(false);
+        calculator.compileInput(expression);
+        calculator.vm->setVar("x", 0.8);
+        double threaded = calculator.executeInstructions();
+        calculator.vm->execute(calculator.compiledInstructions);
+        if(ulpDistance(threaded, calculator.vm->getRegister(calculator.resultRegister)) != 0) {
+            std::cout << "Threaded test failed: " << expression << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << "Threaded tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+int runProgramTests() {
+    int failures = 0;
+
+    // The same source compiles to the same bytes wherever it is compiled
+    Calculator first(false);
+    Calculator second(false);
+    first.compileInput("a=x*2; sin(a)^2 + clamp(y, 0, 1) + 2");
+    second.compileInput("a=x*2; sin(a)^2 + clamp(y, 0, 1) + 2");
+    Program copy = *first.getProgram();
+    if(!(copy == *second.getProgram()) || copy.hash() != second.getProgram()->hash()) {
+        std::cout << "Program test failed: identical programs differ" << std::endl;
+        failures++;
+    }
+    second.compileInput("a=x*2; sin(a)^2 + clamp(y, 0, 1) + 3");
+    if(copy == *second.getProgram() || copy.hash() == second.getProgram()->hash()) {
+        std::cout << "Program test failed: different programs compare equal" << std::endl;
+        failures++;
+    }
+
+    // Symbols name every variable the program touches, in order of first use
+    std::vector<std::string> symbols;
+    for(int i = 0; i < copy.getSymbolCount(); ++i) {
+        symbols.push_back(std::string(copy.getSymbolName(copy.getSymbols()[i])));
+    }
+    if(symbols != std::vector<std::string>{"x", "a", "y"}) {
+        std::cout << "Program test failed: wrong symbol table" << std::endl;
+        failures++;
+    }
+
+    // Repeated constants share a pool entry, and the program is smaller than its instructions
+    Calculator pooled(false);
+    pooled.setOptimize(false);
+    pooled.compileInput("x*2 + 2 + 2*x + 2");
+    if(pooled.getProgram()->getConstantCount() != 1 || pooled.getProgram()->getByteSize() * 4 > pooled.compiledInstructions.size() * sizeof(Instruction)) {
+        std::cout << "Program test failed: " << pooled.getProgram()->getConstantCount() << " constants, " << pooled.getProgram()->getByteSize() << " bytes" << std::endl;
+        failures++;
+    }
+
+    // More live values than a 16 bit register field holds is an error, not a wrapped index
+    std::string wide;
+    const int terms = Program::maxIndex + 10;
+    for(int i = 0; i < terms; ++i) {
+        wide += "x*" + std::to_string(i + 1) + "+(";
+    }
+    wide += "x" + std::string(terms, ')');
+    Calculator large(false);
+    large.compileInput(wide);
+    if(large.resultIsValid() || large.getErrors().empty()) {
+        std::cout << "Program test failed: oversized program was accepted" << std::endl;
+        failures++;
+    }
+
+    // What getProgram hands out after a failed compile runs to NaN, not a read of register -1
+    large.compileInput("1+");
+    ExecutionContext emptyContext;
+    emptyContext.prepare(*large.getProgram());
+    if(large.getProgram()->getResultRegister() >= 0 || !isnan(emptyContext.execute(*large.getProgram()))) {
+        std::cout << "Program test failed: empty program did not run to NaN" << std::endl;
+        failures++;
+    }
+
+    std::cout << "Program tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+int runConcurrencyTests() {
+    int failures = 0;
+    Calculator calculator(false);
+    calculator.compileInput("s=0.5; sin(x)*cos(x*3) + clamp(x, -s, s)^2 + x % 0.3");
+    std::shared_ptr<const Program> program = calculator.getProgram();
+    int xSlot = program->findSlot("x");
+
+    const int samples = 4096;
+    auto sample = [&](ExecutionContext& context, int i) {
+        context.setVar(xSlot, -4. + 8. * i / samples);
+        return context.execute(*program);
+    };
+
+    std::vector<double> serial(samples);
+    ExecutionContext serialContext;
+    serialContext.prepare(*program);
+    for(int i = 0; i < samples; ++i) {
+        serial[i] = sample(serialContext, i);
+    }
+
+    // One shared program, one context per thread, interleaved so threads touch neighbouring outputs
+    const int threadCount = 8;
+    auto contexts = std::make_unique<ExecutionContext[]>(threadCount);
+    std::vector<double> parallel(samples);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            contexts[t].prepare(*program);
+            for(int i = t; i < samples; i += threadCount) {
+                parallel[i] = sample(contexts[t], i);
+            }
+        });
+    }
+    for(auto &i : threads) {
+        i.join();
+    }
+
+    for(int i = 0; i < samples; ++i) {
+        if(ulpDistance(serial[i], parallel[i]) != 0) {
+            std::cout << "Concurrency test failed: sample " << i << " is " << parallel[i] << ", expected " << serial[i] << std::endl;
+            failures++;
+            break;
+        }
+    }
+    if((uintptr_t)&contexts[1] % ExecutionContext::cacheLine != 0 || sizeof(ExecutionContext) % ExecutionContext::cacheLine != 0) {
+        std::cout << "Concurrency test failed: contexts are not cache line aligned" << std::endl;
+        failures++;
+    }
+
+    // Compiling again must not touch a program that has been handed out
+    uint64_t hash = program->hash();
+    calculator.compileInput("x+1");
+    if(program->hash() != hash || calculator.getProgram() == program || serialContext.execute(*program) != serial[samples - 1]) {
+        std::cout << "Concurrency test failed: a shared program was modified" << std::endl;
+        failures++;
+    }
+
+    std::cout << "Concurrency tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+int runSamplerTests() {
+    int failures = 0;
+
+    // Every index is visited exactly once, by a participant that is not running anything else
+    for(int threadCount : {0, 1, 3, 8}) {
+        ThreadPool pool(threadCount);
+        std::vector<std::atomic<int>> visits(10007);
+        std::vector<std::atomic<int>> busy(pool.getParticipantCount());
+        std::atomic<bool> overlapped(false);
+        for(size_t chunkSize : {1, 13, 4096}) {
+            pool.parallelFor(visits.size(), chunkSize, [&](size_t begin, size_t end, int participant) {
+                if(busy[participant]++ != 0) {
+                    overlapped = true;
+                }
+                for(size_t i = begin; i < end; ++i) {
+                    visits[i]++;
+                }
+                busy[participant]--;
+            });
+        }
+        for(auto &i : visits) {
+            if(i != 3) {
+                std::cout << "Sampler test failed: an index was visited " << i << " times with " << threadCount << " threads" << std::endl;
+                failures++;
+                break;
+            }
+        }
+        if(overlapped) {
+            std::cout << "Sampler test failed: a participant ran two chunks at once" << std::endl;
+            failures++;
+        }
+    }
+
+    // Sampling on the pool matches a serial loop bit for bit
+    for(auto &expression : {"sin(x*7)*exp(-x*x) + clamp(x, -0.5, 0.5)^3 + x % 0.3", "2+3"}) {
+        Calculator calculator(false);
+        calculator.compileInput(expression);
+        std::shared_ptr<const Program> program = calculator.getProgram();
+        int slot = program->findSlot("x");
+
+        for(size_t count : {0, 5, 801, 20000}) {
+            std::vector<double> xs(count);
+            for(size_t i = 0; i < count; ++i) {
+                xs[i] = -3. + 6. * i / count;
+            }
+
+            std::vector<double> serial(count);
+            ExecutionContext context;
+            context.prepare(*program);
+            for(size_t i = 0; i < count; ++i) {
+                if(slot >= 0) {
+                    context.setVar(slot, xs[i]);
+                }
+                serial[i] = context.execute(*program);
+            }
+
+            for(size_t chunkSize : {(size_t)1, (size_t)7, GraphSampler::defaultChunkSize}) {
+                GraphSampler sampler(std::make_shared<ThreadPool>(4), chunkSize);
+                std::vector<double> sampled(count, -1.);
+                sampler.sample(*program, slot, xs.data(), sampled.data(), count);
+                for(size_t i = 0; i < count; ++i) {
+                    if(ulpDistance(serial[i], sampled[i]) != 0) {
+                        std::cout << "Sampler test failed: " << expression << " sample " << i << " of " << count << " differs" << std::endl;
+                        failures++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    std::cout << "Sampler tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+// Largest distance between expression and the lines joining the samples, checked on a dense grid
+static double interpolationError(const Program& program, int slot, const std::vector<double>& xs, const std::vector<double>& ys) {
+    ExecutionContext context;
+    context.prepare(program);
+    double error = 0.;
+    size_t segment = 0;
+    const int checks = 20000;
+    for(int i = 0; i <= checks; ++i) {
+        double x = xs.front() + (xs.back() - xs.front()) * i / checks;
+        while(segment + 2 < xs.size() && xs[segment + 1] < x) {
+            segment++;
+        }
+        double t = (x - xs[segment]) / (xs[segment + 1] - xs[segment]);
+        context.setVar(slot, x);
+        error = std::max(error, std::fabs(context.execute(program) - (ys[segment] + (ys[segment + 1] - ys[segment]) * t)));
+    }
+    return error;
+}
+
+int runAdaptiveTests() {
+    int failures = 0;
+    GraphSampler sampler(std::make_shared<ThreadPool>(3));
+
+    // A narrow spike on a flat line, which a uniform grid either misses or oversamples
+    for(size_t maxEvaluations : {(size_t)100, (size_t)4096}) {
+        Calculator calculator(false);
+        calculator.compileInput("1/(1+(x*50)^2) + sin(x*3)*0.2");
+        std::shared_ptr<const Program> program = calculator.getProgram();
+        int slot = program->findSlot("x");
+
+        GraphSampler::AdaptiveSettings settings;
+        settings.tolerance = 1e-3;
+        settings.maxEvaluations = maxEvaluations;
+        std::vector<double> xs;
+        std::vector<double> ys;
+        size_t evaluations = sampler.sampleAdaptive(*program, slot, settings, xs, ys);
+        if(evaluations > maxEvaluations || xs.size() != evaluations || ys.size() != evaluations) {
+            std::cout << "Adaptive test failed: " << evaluations << " evaluations for " << xs.size() << " samples, cap " << maxEvaluations << std::endl;
+            failures++;
+            continue;
+        }
+        if(xs.front() != settings.start || xs.back() != settings.end || !std::is_sorted(xs.begin(), xs.end())
+            || std::adjacent_find(xs.begin(), xs.end()) != xs.end()) {
+            std::cout << "Adaptive test failed: samples are not increasing from start to end" << std::endl;
+            failures++;
+        }
+
+        ExecutionContext context;
+        context.prepare(*program);
+        for(size_t i = 0; i < xs.size(); ++i) {
+            context.setVar(slot, xs[i]);
+            if(ulpDistance(context.execute(*program), ys[i]) != 0) {
+                std::cout << "Adaptive test failed: sample " << i << " differs from evaluating it directly" << std::endl;
+                failures++;
+                break;
+            }
+        }
+
+        // With room to finish, the curve is within the tolerance with far fewer samples
+        // than a uniform grid that resolves the spike as well
+        if(maxEvaluations == 4096) {
+            double error = interpolationError(*program, slot, xs, ys);
+            std::vector<double> uniformXs(evaluations);
+            std::vector<double> uniformYs(evaluations);
+            for(size_t i = 0; i < evaluations; ++i) {
+                uniformXs[i] = settings.start + (settings.end - settings.start) * i / (evaluations - 1);
+            }
+            sampler.sample(*program, slot, uniformXs.data(), uniformYs.data(), evaluations);
+            double uniformError = interpolationError(*program, slot, uniformXs, uniformYs);
+            if(error > settings.tolerance * 2 || error * 4 > uniformError || evaluations > 1000) {
+                std::cout << "Adaptive test failed: error " << error << " from " << evaluations << " samples, uniform error " << uniformError << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    // A straight line needs one round of midpoints to confirm it
+    {
+        Calculator calculator(false);
+        calculator.compileInput("2*x+1");
+        std::shared_ptr<const Program> program = calculator.getProgram();
+        GraphSampler::AdaptiveSettings settings;
+        std::vector<double> xs;
+        std::vector<double> ys;
+        size_t evaluations = sampler.sampleAdaptive(*program, program->findSlot("x"), settings, xs, ys);
+        if(evaluations != settings.initialIntervals * 2 + 1) {
+            std::cout << "Adaptive test failed: a line took " << evaluations << " evaluations" << std::endl;
+            failures++;
+        }
+    }
+
+    // Where the curve stops being defined is located as closely as the depth allows, or
+    // with culling until sqrt rises by less than the tolerance, within tolerance^2 of it
+    for(bool cull : {false, true}) {
+        Calculator calculator(false);
+        calculator.compileInput("sqrt(x - 0.3)");
+        std::shared_ptr<const Program> program = calculator.getProgram();
+        GraphSampler::AdaptiveSettings settings;
+        settings.cull = cull;
+        std::vector<double> xs;
+        std::vector<double> ys;
+        sampler.sampleAdaptive(*program, program->findSlot("x"), settings, xs, ys);
+        size_t firstFinite = 0;
+        while(firstFinite < ys.size() && !std::isfinite(ys[firstFinite])) {
+            firstFinite++;
+        }
+        double finest = cull ? settings.tolerance * settings.tolerance : (settings.end - settings.start) / settings.initialIntervals / (1 << settings.maxDepth);
+        if(firstFinite == 0 || firstFinite == ys.size() || xs[firstFinite] - xs[firstFinite - 1] > finest * 2 || xs[firstFinite] < 0.3) {
+            std::cout << "Adaptive test failed: the edge of the domain was not located" << (cull ? " with culling" : "") << std::endl;
+            failures++;
+        }
+    }
+
+    // Poles and steep curves leaving the view are not refined out of view
+    for(auto &expression : {"tan(x*5)", "1/x", "exp(x*8)-2"}) {
+        Calculator calculator(false);
+        calculator.compileInput(expression);
+        std::shared_ptr<const Program> program = calculator.getProgram();
+        int slot = program->findSlot("x");
+        GraphSampler::AdaptiveSettings settings;
+        settings.bottom = -1.;
+        settings.top = 1.;
+        std::vector<double> xs;
+        std::vector<double> ys;
+        settings.cull = false;
+        size_t all = sampler.sampleAdaptive(*program, slot, settings, xs, ys);
+        settings.cull = true;
+        size_t culled = sampler.sampleAdaptive(*program, slot, settings, xs, ys);
+
+        // What is in view is still within the tolerance, away from the breaks themselves
+        ExecutionContext context;
+        context.prepare(*program);
+        double error = 0.;
+        for(size_t i = 0; i + 1 < xs.size(); ++i) {
+            for(double t : {0.25, 0.5, 0.75}) {
+                double x = xs[i] + (xs[i + 1] - xs[i]) * t;
+                context.setVar(slot, x);
+                double y = std::clamp(context.execute(*program), -1., 1.);
+                double line = std::clamp(ys[i] + (ys[i + 1] - ys[i]) * t, -1., 1.);
+                if(xs[i + 1] - xs[i] > 1e-6) {
+                    error = std::max(error, std::fabs(y - line));
+                }
+            }
+        }
+        if(culled * 4 > all || error > settings.tolerance * 2) {
+            std::cout << "Adaptive test failed: " << expression << " took " << culled << " evaluations culled, " << all << " not, error " << error << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << "Adaptive tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+int runIntervalTests() {
+    int failures = 0;
+
+    // Every builtin on its own and in the positions its arguments can take, and every operator
+    std::vector<std::string> expressions;
+    const double arguments[] = {0.3, 0.7};
+    for(auto &function : Functions::getFunctions()) {
+        for(int position = 0; position < function.arity; ++position) {
+            std::string expression = function.name + "(";
+            for(int a = 0; a < function.arity; ++a) {
+                expression += a == 0 ? "" : ", ";
+                expression += a == position ? "x" : Helper::toShortestString(arguments[a == 0 ? 0 : a - 1]);
+            }
+            expressions.push_back(expression + ")");
+        }
+    }
+    for(auto &expression : {"x+1", "2-x", "x*x", "x*x*x - x", "1/x", "3/(x-0.5)", "x/3", "x^2", "x^3", "x^-2", "x^-3", "x^0.5",
+        "x^x", "2^x", "(0-2)^x", "x^0", "x % 0.3", "x % -0.7", "0.3 % x", "x % x", "a=x*2; sin(a)^2 + cos(a)^2 + a",
+        "x*3+1", "clamp(x*3, -1, 1) + 2 - x + 7/x", "tan(x*5)", "sqrt(x-0.2)*log(x+0.1)", "floor(x*3) + fract(x*2)",
+        "atan2(x, x-0.5)", "atan2(0-x, 0-1)", "sin(1/x)", "exp(x*300)", "1/(1+(x*50)^2)"}) {
+        expressions.push_back(expression);
+    }
+
+    // Boxes of widths from a millionth to several periods, scattered by a fixed generator
+    uint64_t state = 12345;
+    auto random = [&]() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 11) * (1. / 9007199254740992.);
+    };
+
+    for(auto &expression : expressions) {
+        Calculator calculator(false);
+        calculator.compileInput(expression);
+        std::shared_ptr<const Program> program = calculator.getProgram();
+        int slot = program->findSlot("x");
+        ExecutionContext scalar;
+        scalar.prepare(*program);
+        IntervalContext interval;
+        interval.prepare(*program);
+
+        for(int box = 0; box < 200; ++box) {
+            double lo = random() * 8. - 4.;
+            double hi = lo + std::pow(10., random() * 7. - 6.);
+            if(box % 10 == 0) {
+                // Endpoints on the special points of many functions
+                lo = std::round(lo);
+                hi = lo + (box % 20 == 0 ? 0. : 1.);
+            }
+            interval.setVar(slot, Interval::range(lo, hi));
+            Interval bound = interval.execute(*program);
+
+            bool undefined = false;
+            for(int i = 0; i <= 64; ++i) {
+                double x = i == 64 ? hi : lo + (hi - lo) * i / 64;
+                scalar.setVar(slot, x);
+                double y = scalar.execute(*program);
+                if(std::isnan(y)) {
+                    undefined = true;
+                } else if(!bound.contains(y)) {
+                    std::cout << "Interval test failed: " << expression << " at " << x << " is " << y << ", outside [" << bound.lo << ", " << bound.hi
+                        << "] for [" << lo << ", " << hi << "]" << std::endl;
+                    failures++;
+                    break;
+                }
+            }
+            if(undefined && bound.continuous) {
+                std::cout << "Interval test failed: " << expression << " is undefined in [" << lo << ", " << hi << "] but claimed continuous" << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    // Breaks are found and smooth pieces bounded closely
+    struct Case {
+        const char* expression;
+        double lo;
+        double hi;
+        bool continuous;
+        double boundLo;
+        double boundHi;
+    };
+    const Case cases[] = {
+        {"tan(x)", 1.5, 1.6, false, -INFINITY, INFINITY},
+        {"tan(x)", -1., 1., true, -1.5574077246549023, 1.5574077246549023},
+        {"1/x", -1., 1., false, -INFINITY, INFINITY},
+        {"1/x", 0.5, 2., true, 0.5, 2.},
+        {"floor(x)", 0.5, 1.5, false, 0., 1.},
+        {"sqrt(x)", -1., 4., false, 0., 2.},
+        {"x*x", -1., 2., true, 0., 4.},
+        {"x^2", -1., 2., true, 0., 4.},
+        {"sin(x)", 0., 1., true, 0., 0.8414709848078965},
+        {"sin(x)", 1., 2., true, 0.8414709848078965, 1.},
+        {"x % 1", 0.25, 0.75, true, 0.25, 0.75},
+        {"x % 1", 0.75, 1.25, false, 0., 1.},
+    };
+    for(auto &i : cases) {
+        Calculator calculator(false);
+        calculator.compileInput(i.expression);
+        std::shared_ptr<const Program> program = calculator.getProgram();
+        IntervalContext interval;
+        interval.prepare(*program);
+        interval.setVar(program->findSlot("x"), Interval::range(i.lo, i.hi));
+        Interval bound = interval.execute(*program);
+        double slack = 1e-12 * std::max(1., std::fabs(i.boundHi - i.boundLo));
+        bool tight = std::isinf(i.boundLo) ? bound.lo == i.boundLo : std::fabs(bound.lo - i.boundLo) <= slack;
+        tight = tight && (std::isinf(i.boundHi) ? bound.hi == i.boundHi : std::fabs(bound.hi - i.boundHi) <= slack);
+        if(bound.continuous != i.continuous || !tight) {
+            std::cout << "Interval test failed: " << i.expression << " over [" << i.lo << ", " << i.hi << "] is [" << bound.lo << ", " << bound.hi << "]"
+                << (bound.continuous ? " continuous" : " broken") << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << "Interval tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+int runTripleBufferTests() {
+    int failures = 0;
+    TripleBuffer<std::vector<int>> buffer;
+    if(buffer.take()) {
+        std::cout << "Triple buffer test failed: took a value before any was published" << std::endl;
+        failures++;
+    }
+
+    // The consumer may skip values but never sees one older than the last, or a torn one
+    const int last = 200000;
+    std::thread producer([&]() {
+        for(int i = 1; i <= last; ++i) {
+            std::vector<int>& slot = buffer.write();
+            slot.assign(4, i);
+            buffer.publish();
+        }
+    });
+    int seen = 0;
+    int takes = 0;
+    while(seen < last) {
+        if(!buffer.take()) {
+            continue;
+        }
+        takes++;
+        const std::vector<int>& value = buffer.read();
+        if(value.size() != 4 || value[0] <= seen || value[0] != value[3]) {
+            std::cout << "Triple buffer test failed: read " << (value.empty() ? -1 : value[0]) << " after " << seen << std::endl;
+            failures++;
+            break;
+        }
+        seen = value[0];
+    }
+    producer.join();
+    if(buffer.take()) {
+        std::cout << "Triple buffer test failed: took the last value twice" << std::endl;
+        failures++;
+    }
+    if(buffer.read()[0] != last) {
+        std::cout << "Triple buffer test failed: ended on " << buffer.read()[0] << ", expected " << last << std::endl;
+        failures++;
+    }
+    if(takes == 0) {
+        std::cout << "Triple buffer test failed: nothing taken" << std::endl;
+        failures++;
+    }
+    std::cout << "Triple buffer tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+// Polls until worker shows version and, for a graph, its curve, or gives up after 10s
+static bool waitForEvaluation(EvaluationWorker& worker, uint64_t version, bool curve = false) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(std::chrono::steady_clock::now() < deadline) {
+        worker.poll();
+        const Evaluation& evaluation = worker.current();
+        if(evaluation.version == version && (!curve || evaluation.hasCurve)) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return false;
+}
+
+int runWorkerTests() {
+    int failures = 0;
+    std::atomic<int> publishes(0);
+    EvaluationWorker worker([&]() { publishes++; });
+    GraphSampler::AdaptiveSettings settings;
+
+    // Typed a character at a time without waiting, whatever was skipped the last input wins
+    std::string typed = "s=2; (s+1.5)*4 - sqrt(16)";
+    uint64_t version = 0;
+    for(size_t i = 1; i <= typed.size(); ++i) {
+        version = worker.submit(typed.substr(0, i), settings);
+    }
+    if(!waitForEvaluation(worker, version)) {
+        std::cout << "Worker test failed: version " << version << " never arrived" << std::endl;
+        return failures + 1;
+    }
+    const Evaluation& typedResult = worker.current();
+    if(!typedResult.valid || typedResult.isGraph || typedResult.result != 10. || typedResult.tokens.source != typed || typedResult.instructions.empty()) {
+        std::cout << "Worker test failed: " << typed << " evaluated to " << typedResult.result << std::endl;
+        failures++;
+    }
+
+    // Errors own their text, it outlives the worker's next compile
+    version = worker.submit("1+", settings);
+    waitForEvaluation(worker, version);
+    if(worker.current().valid || worker.current().errors.empty() || worker.current().errors[0].value.empty()) {
+        std::cout << "Worker test failed: 1+ reported no error" << std::endl;
+        failures++;
+    }
+
+    // A graph far too expensive to finish is cancelled by the next input, its curve never shows
+    GraphSampler::AdaptiveSettings heavy;
+    heavy.tolerance = 0;
+    heavy.maxEvaluations = 1 << 21;
+    heavy.maxDepth = 30;
+    heavy.cull = false;
+    uint64_t heavyVersion = worker.submit("sin(x*40)*exp(cos(x*3))+atan(x)", heavy);
+    waitForEvaluation(worker, heavyVersion);
+    version = worker.submit("x*2", settings);
+    bool sawHeavyCurve = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(std::chrono::steady_clock::now() < deadline) {
+        worker.poll();
+        const Evaluation& evaluation = worker.current();
+        sawHeavyCurve |= evaluation.version == heavyVersion && evaluation.hasCurve;
+        if(evaluation.version == version && evaluation.hasCurve) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    const Evaluation& line = worker.current();
+    if(sawHeavyCurve || line.version != version || !line.hasCurve || line.xs.size() < 2) {
+        std::cout << "Worker test failed: stale graph shown or x*2 not sampled" << std::endl;
+        failures++;
+    } else {
+        for(size_t i = 0; i < line.xs.size(); ++i) {
+            if(line.ys[i] != line.xs[i] * 2) {
+                std::cout << "Worker test failed: x*2 at " << line.xs[i] << " is " << line.ys[i] << std::endl;
+                failures++;
+                break;
+            }
+        }
+    }
+
+    // Text that compiles to the same program keeps its curve without sampling again, one
+    // publish for it and one for the input after
+    uint64_t lineHash = line.curveHash;
+    int before = publishes.load();
+    version = worker.submit("x * 2", settings);
+    waitForEvaluation(worker, version);
+    if(!worker.current().hasCurve || worker.current().curveHash != lineHash) {
+        std::cout << "Worker test failed: unchanged curve not carried over" << std::endl;
+        failures++;
+    }
+    version = worker.submit("1", settings);
+    waitForEvaluation(worker, version);
+    if(publishes.load() - before != 2) {
+        std::cout << "Worker test failed: " << publishes.load() - before << " publishes for an unchanged curve, expected 2" << std::endl;
+        failures++;
+    }
+
+    // Other settings are another curve
+    GraphSampler::AdaptiveSettings wide = settings;
+    wide.end = 4;
+    version = worker.submit("x*2", wide);
+    if(!waitForEvaluation(worker, version, true) || worker.current().curveHash == lineHash || worker.current().xs.back() != 4) {
+        std::cout << "Worker test failed: changed settings not resampled" << std::endl;
+        failures++;
+    }
+    std::cout << "Worker tests " << (failures == 0 ? "passed" : "failed") << std::endl;
+    return failures;
+}
+
+int runJitTests() {
+    if(!JitProgram::isSupported()) {
+        std::cout << "JIT tests skipped, no native backend for this target" << std::endl;
+        return 0;
+    }
+
+    // Between them these reach every opcode, optimized and verbatim
+    const std::vector<std::string> testCases = {
+        "x*2+1",
+        "(x+1)*(x-1)/(x*x+1) - x^3 + x % 1.7",
+        "2 - x + 3/(x+8.5) + x/3 + x^1.5",
+        "x*(x+1) + x",
+        "sin(x) + cos(x) + sqrt(abs(x)) + rsqrt(x*x+1)",
+        "max(x, min(x*x, 0.5)) - clamp(x, -0.25, 0.25) + atan2(x, 2)",
+        "scale=.5; v=(sin(x*pi*40) * scale); v2=sin(x*pi*.3); clamp(v+v2,-.25,.25)-v2+(x*1.2)",
+        "a=x; a=(a+1); a*a + y",
+    };
+
+    int failures = 0;
+    for(auto &expression : testCases) {
+        for(bool optimize : {false, true}) {
+            Calculator interpreted(false);
+            interpreted.setOptimize(optimize);
+            interpreted.compileInput(expression);
+
+            Calculator jit(false);
+            jit.setOptimize(optimize);
+            jit.setJit(true);
+            jit.compileInput(expression);
+
+            if(!jit.isJitCompiled()) {
+                std::cout << "JIT test failed: '" << expression << "' was not compiled" << std::endl;
+                failures++;
+                break;
+            }
+
+            interpreted.vm->setVar("y", 0.25);
+            jit.vm->setVar("y", 0.25);
+            auto interpretedX = interpreted.vm->bind("x");
+            auto jitX = jit.vm->bind("x");
+            for(double x = -4.; x <= 4.; x += 1. / 64.) {
+                interpreted.vm->setVar(interpretedX, x);
+                jit.vm->setVar(jitX, x);
+                double expected = interpreted.executeInstructions();
+                double result = jit.executeInstructions();
+                if(ulpDistance(expected, result) != 0 || interpreted.vm->getVar("a") != jit.vm->getVar("a")) {
+                    std::cout << "JIT test failed: '" << expression << "' at x=" << x << ", expected: " << expected << ", got: " << result << std::endl;
+                    failures++;
+                    break;
+                }
+            }
+        }
+    }
+    // Native code isn't bounds checked, a register file too small for the program is refused
+    Calculator small(false);
+    small.compileInput("(x+1)*(x-1)/(x*x+1)");
+    if(JitProgram::compile(small.compiledInstructions, small.registerCount - 1, small.resultRegister) != nullptr ||
+        JitProgram::compile(small.compiledInstructions, small.registerCount, small.resultRegister) == nullptr) {
+        std::cout << "JIT test failed: register count not checked" << std::endl;
+        failures++;
+    }
+
+    std::cout << "JIT tests passed " << testCases.size() * 2 - failures << "/" << testCases.size() * 2 << std::endl;
+    return failures;
+}
+
+int main() {
+    int failures = 0;
+    failures += runExpressionTests();
+    failures += runTokenizerTests();
+    failures += runLiteralTests();
+    failures += runErrorTests();
+    failures += runDeepNestingTests();
+    failures += runAllocationTests();
+    failures += runVariableSlotTests();
+    failures += runOptimizerTests();
+    failures += runPeepholeTests();
+    failures += runVerifierTests();
+    failures += runBatchTests();
+    failures += runThreadedTests();
+    failures += runProgramTests();
+    failures += runConcurrencyTests();
+    failures += runSamplerTests();
+    failures += runAdaptiveTests();
+    failures += runIntervalTests();
+    failures += runTripleBufferTests();
+    failures += runWorkerTests();
+    failures += runJitTests();
+    return failures == 0 ? 0 : 1;
+}
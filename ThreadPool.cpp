@@ -0,0 +1,114 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) :generation(0), pendingChunks(0), stopping(false) {
+    if(threadCount < 0) {
+        threadCount = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+    }
+
+    for(int i = 0; i <= threadCount; ++i) {
+        queues.push_back(std::make_unique<Worker>());
+    }
+    for(int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto &i : threads) {
+        i.join();
+    }
+}
+
+int ThreadPool::getParticipantCount() const {
+    return queues.size();
+}
+
+void ThreadPool::parallelFor(size_t count, size_t chunkSize, const Body_t& body) {
+    if(count == 0) {
+        return;
+    }
+    chunkSize = std::max<size_t>(chunkSize, 1);
+    std::lock_guard<std::mutex> serialize(parallelForMutex);
+
+    // Contiguous runs of chunks per queue, so each participant starts on its own stretch of
+    // the range and only steals once it has finished it
+    size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+    size_t participants = queues.size();
+    pendingChunks = chunkCount;
+    for(size_t q = 0; q < participants; ++q) {
+        size_t first = chunkCount * q / participants;
+        size_t last = chunkCount * (q + 1) / participants;
+        std::lock_guard<std::mutex> lock(queues[q]->mutex);
+        // Owners pop from the back, so push in reverse to run the stretch front to back
+        for(size_t c = last; c-- > first;) {
+            queues[q]->chunks.push_back({c * chunkSize, std::min(count, (c + 1) * chunkSize), &body});
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    work(participants - 1);
+
+    std::unique_lock<std::mutex> lock(stateMutex);
+    done.wait(lock, [this]() { return pendingChunks == 0; });
+}
+
+bool ThreadPool::take(int participant, Chunk& chunk) {
+    {
+        Worker& own = *queues[participant];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.chunks.empty()) {
+            chunk = own.chunks.back();
+            own.chunks.pop_back();
+            return true;
+        }
+    }
+
+    for(size_t offset = 1; offset < queues.size(); ++offset) {
+        Worker& victim = *queues[(participant + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.chunks.empty()) {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(int participant) {
+    Chunk chunk;
+    while(take(participant, chunk)) {
+        (*chunk.body)(chunk.begin, chunk.end, participant);
+        if(--pendingChunks == 0) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::run(int participant) {
+    uint64_t seen = 0;
+    for(;;) {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if(stopping) {
+                return;
+            }
+            seen = generation;
+        }
+        work(participant);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+
+// Fixed set of worker threads that split a range of indices between them. Each worker
+// has its own queue of chunks, takes work from the back of it and, once it runs dry,
+// steals from the front of the others, so uneven chunks (expensive parts of a curve)
+// balance out without a central queue.
+class ThreadPool {
+    public:
+    // Called with a chunk [begin, end) and the index of the participant running it, which
+    // is below getParticipantCount() and never used by two chunks at the same time
+    typedef std::function<void(size_t begin, size_t end, int participant)> Body_t;
+
+    // Negative uses one thread per hardware thread minus the caller's, which on a single
+    // core is none and parallelFor runs on the caller alone
+    explicit ThreadPool(int threadCount = -1);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs body over [0, count) in chunks of at most chunkSize and returns when all are
+    // done. The calling thread works too. Calls from different threads run one at a time.
+    void parallelFor(size_t count, size_t chunkSize, const Body_t& body);
+
+    // Workers plus the calling thread
+    int getParticipantCount() const;
+
+    private:
+    // Chunks carry their body, a worker that wakes late may take a chunk of a later call
+    struct Chunk {
+        size_t begin;
+        size_t end;
+        const Body_t* body;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    void run(int participant);
+    // Runs chunks from participant's queue, then stolen ones, until every queue is empty
+    void work(int participant);
+    bool take(int participant, Chunk& chunk);
+
+    // One queue per participant, the caller's is last
+    std::vector<std::unique_ptr<Worker>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex parallelForMutex;
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation;
+    std::atomic<size_t> pendingChunks;
+    bool stopping;
+};
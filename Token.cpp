@@ -1,20 +1,11 @@
 #include "Token.h"
 #include "Constants.h"
 #include "Functions.h"
-#include "Parser.h"
 
-Token::Token() : value(""), type(Type::TOKEN_NULL), depth(0), pairId(0) {
+Token::Token() :type(Type::TOKEN_NULL), depth(0), pairId(0), offset(0), length(0), number(0.) {
 }
 
-Token::Token(int type, std::string value) :type(type), value(value), depth(0), pairId(0) {
-}
-
-std::string Token::getValue() const {
-    return value;
-}
-
-void Token::setValue(std::string nValue) {
-    value = nValue;
+Token::Token(int type, uint32_t offset, uint32_t length) :type(type), depth(0), pairId(0), offset(offset), length(length), number(0.) {
 }
 
 int Token::getType() const {
@@ -25,7 +16,7 @@ void Token::setType(int nType) {
     type = nType;
 }
 
-const bool Token::isParenthesis() {
+bool Token::isParenthesis() const {
     return isType(Token::TOKEN_OPEN_PARENTHESIS) || isType(Token::TOKEN_CLOSE_PARENTHESIS);
 }
 
@@ -33,65 +24,16 @@ bool Token::isType(int v) const {
     return v == type;
 }
 
-bool Token::isConstantIdentifier() const {
-    return Constants::exists(value);
+bool Token::isConstantIdentifier(std::string_view source) const {
+    return Constants::exists(getValue(source));
 }
 
-bool Token::isFunctionIdentifier() const {
-    return Functions::exists(value);
+bool Token::isFunctionIdentifier(std::string_view source) const {
+    return Functions::exists(getValue(source));
 }
 
-bool Token::isResolved() const {
-    return isConstantIdentifier() || isFunctionIdentifier();
-}
-
-bool Token::isValidOperator() {
-    if(value.length() != 1) //TODO add support for multi-char operators
-        return false;
-
-    for(auto &i : Parser::operators) {
-        if(i.first == value[0])
-            return true;
-    }
-
-    return false;
-}
-
-glm::vec4 Token::getColor() {
-    glm::vec3 num = glm::vec3(0., 255., 188) / glm::vec3(256.);
-    glm::vec3 identifer = glm::vec3(251, 243, 0) / glm::vec3(256.);
-    glm::vec3 unresolved = glm::vec3(241, 170, 18) / glm::vec3(256.);
-    glm::vec3 constant = glm::vec3(174, 241, 18) / glm::vec3(256.);
-
-    glm::vec3 oper = glm::vec3(184, 184, 184) / glm::vec3(256.);
-    glm::vec3 parenths = glm::vec3(160, 160, 160) / glm::vec3(256.);
-
-    const std::map<int, glm::vec3> tokenColours = {
-        {Token::TOKEN_NUMBER, num},
-        {Token::TOKEN_OPERATOR, oper},
-        {Token::TOKEN_EXPRESSION, oper},
-        {Token::TOKEN_WHITESPACE, glm::vec3(1., 1., 1.)},
-        {Token::TOKEN_OPEN_PARENTHESIS, parenths},
-        {Token::TOKEN_CLOSE_PARENTHESIS, parenths},
-        {Token::TOKEN_COMMA, parenths},
-        {Token::TOKEN_IDENTIFIER, identifer},
-        {Token::TOKEN_SEMICOLON, parenths},
-        {Token::TOKEN_FUNCTION, identifer},
-        {Token::TOKEN_NULL, glm::vec3(1., 1., 1.)},
-        {Token::TOKEN_UNKNOWN, glm::vec3(.5)},
-    };
-
-    glm::vec3 color = tokenColours.at(type);
-
-    if(isType(Token::TOKEN_IDENTIFIER)) {
-        if(!isResolved()) {
-            color = unresolved;
-        } else if (isConstantIdentifier()) {
-            color = constant;
-        }
-    }
-
-    return glm::vec4(color, 1.);
+bool Token::isResolved(std::string_view source) const {
+    return isConstantIdentifier(source) || isFunctionIdentifier(source);
 }
 
 void Token::setDepth(int nDepth) {
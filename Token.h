@@ -1,32 +1,48 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <vector>
-#include <glm/glm.hpp>
-
-class Token;
+#include <cstdint>
 
+// A span of the source text owned by a TokenList. Tokens hold no text of their own so
+// they are trivially copyable and tokenizing allocates nothing beyond the token vector.
 class Token {
 public:
     Token();
-    Token(int type, std::string value);
-    
-    std::string getValue() const;
-    void setValue(std::string nValue);
+    Token(int type, uint32_t offset, uint32_t length);
+
+    std::string_view getValue(std::string_view source) const {
+        return source.substr(offset, length);
+    }
+    uint32_t getOffset() const {
+        return offset;
+    }
+    uint32_t getLength() const {
+        return length;
+    }
+    void setOffset(uint32_t nOffset) {
+        offset = nOffset;
+    }
+
+    // Value of a TOKEN_NUMBER, parsed by the tokenizer, NaN if the literal is malformed
+    double getNumber() const {
+        return number;
+    }
+    void setNumber(double nNumber) {
+        number = nNumber;
+    }
 
     int getType() const;
     void setType(int nType);
-    const bool isParenthesis();
+    bool isParenthesis() const;
     bool isType(int v) const;
 
-    bool isConstantIdentifier() const;
-    bool isFunctionIdentifier() const;
-    bool isResolved() const;
+    bool isConstantIdentifier(std::string_view source) const;
+    bool isFunctionIdentifier(std::string_view source) const;
+    bool isResolved(std::string_view source) const;
 
-    bool isValidOperator();
-    glm::vec4 getColor();
-    
     void setDepth(int nDepth);
     int getDepth() const;
 
@@ -54,6 +70,8 @@ private:
     int type;
     int depth;
     int pairId;
-    std::string value;
+    uint32_t offset;
+    uint32_t length;
+    double number;
     static const std::map<int, std::string> tokenNames;
-};
\ No newline at end of file
+};
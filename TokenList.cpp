@@ -3,23 +3,28 @@
 
 #include <iostream>
 
-void TokenList::print() {
+void TokenList::clear() {
+    source.clear();
+    list.clear();
+}
+
+void TokenList::print() const {
     for(auto &i : list) {
-        std::cout << i.getName() << " : '" << i.getValue() << "'" << std::endl;
+        std::cout << i.getName() << " : '" << getValue(i) << "'" << std::endl;
     }
 }
 
-void TokenList::printShort() {
+void TokenList::printShort() const {
     for(auto &i : list) {
-        std::cout << i.getValue();
+        std::cout << getValue(i);
     }
     std::cout << std::endl;
 }
 
-std::string TokenList::toString() {
+std::string TokenList::toString() const {
     std::string str = "";
     for(auto &i : list) {
-        str += i.getValue();
+        str += getValue(i);
     }
     return str;
-}
\ No newline at end of file
+}
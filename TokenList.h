@@ -1,13 +1,24 @@
 #pragma once
 
 #include <vector>
-class Token;
+#include <string>
+#include <string_view>
 
+#include "Token.h"
+
+// Tokens and the text they index into. Parser::parseInput reuses both buffers, so a
+// TokenList kept across calls stops allocating once it has seen its longest input.
 class TokenList {
     public:
+    std::string source;
     std::vector<Token> list;
 
-    void print();
-    void printShort();
-    std::string toString();
-};
\ No newline at end of file
+    std::string_view getValue(const Token& token) const {
+        return token.getValue(source);
+    }
+
+    void clear();
+    void print() const;
+    void printShort() const;
+    std::string toString() const;
+};
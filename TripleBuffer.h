@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Hands values from one producer thread to one consumer thread without locks or waiting.
+// Of three slots the producer fills one, the consumer reads another and the third holds
+// the latest published value. Publishing and taking swap a slot with that middle one, so
+// the consumer always moves to the newest complete value and values it missed are dropped.
+template<typename T>
+class TripleBuffer {
+    public:
+    TripleBuffer() :middle(1), back(0), front(2) {
+    }
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Producer: the slot to fill before publish, holding whatever was last published
+    // from it, so its allocations are reused
+    T& write() {
+        return slots[back].value;
+    }
+
+    // Producer: makes the filled slot the latest value
+    void publish() {
+        back = middle.exchange(back | fresh, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // Consumer: moves to the latest value if one was published since the last take,
+    // returns whether it did
+    bool take() {
+        if(!(middle.load(std::memory_order_relaxed) & fresh)) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    // Consumer: the value moved to by the last take, default constructed before the first
+    const T& read() const {
+        return slots[front].value;
+    }
+
+    private:
+    static const uint8_t indexMask = 3;
+    // Set in middle while it holds a value the consumer hasn't taken
+    static const uint8_t fresh = 4;
+
+    // Each on its own cache line, the threads write different slots
+    struct alignas(64) Slot {
+        T value;
+    };
+    Slot slots[3];
+
+    // Index of the middle slot and the fresh bit, the only state both threads touch
+    alignas(64) std::atomic<uint8_t> middle;
+    // Producer only
+    alignas(64) uint8_t back;
+    // Consumer only
+    alignas(64) uint8_t front;
+};
@@ -0,0 +1,57 @@
+#include "Verifier.h"
+#include "Instruction.h"
+#include "Functions.h"
+#include "Arena.h"
+
+const char* Verifier::verify(const std::vector<Instruction>& instructions, int registerCount, int resultRegister, int variableCount, Arena& arena) {
+    ArenaVector<bool> written(registerCount, false, arena);
+    int functionCount = Functions::getFunctions().size();
+    int sources[3];
+    int destinations[2];
+
+    for(const auto &i : instructions) {
+        int operation = i.getOperation();
+        if(operation < 0 || operation >= Instruction::OP_COUNT) {
+            return "Unknown operation";
+        }
+
+        int sourceCount = i.getSources(sources);
+        for(int s = 0; s < sourceCount; ++s) {
+            if(sources[s] < 0 || sources[s] >= registerCount) {
+                return "Register out of range";
+            }
+            if(!written[sources[s]]) {
+                return "Register read before it is written";
+            }
+        }
+
+        if(operation == Instruction::OP_LOAD_VARIABLE && (i.getA() < 0 || i.getA() >= variableCount)) {
+            return "Variable slot out of range";
+        }
+        if(operation == Instruction::OP_STORE_VARIABLE && (i.getB() < 0 || i.getB() >= variableCount)) {
+            return "Variable slot out of range";
+        }
+        if(operation >= Instruction::OP_CALL1 && operation <= Instruction::OP_CALL3) {
+            int id = i.getOperand().getFunctionId();
+            if(i.getOperand().getType() != Operand::TYPE_FUNCTION || id < 0 || id >= functionCount) {
+                return "Unknown function";
+            }
+            if(Functions::get(id).arity != operation - Instruction::OP_CALL1 + 1) {
+                return "Call does not match function arity";
+            }
+        }
+
+        int destinationCount = i.getDestinations(destinations);
+        for(int d = 0; d < destinationCount; ++d) {
+            if(destinations[d] < 0 || destinations[d] >= registerCount) {
+                return "Register out of range";
+            }
+            written[destinations[d]] = true;
+        }
+    }
+
+    if(resultRegister < 0 || resultRegister >= registerCount || !written[resultRegister]) {
+        return "Result is never computed";
+    }
+    return nullptr;
+}
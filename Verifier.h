@@ -0,0 +1,15 @@
+#pragma once
+#include <vector>
+
+class Instruction;
+class Arena;
+
+// Checks a compiled program before it is run. The VMs and the JIT trust verified programs
+// completely: they do no bounds checks and never grow their buffers while executing.
+class Verifier {
+    public:
+    // Returns nullptr if every register is in range and written before it is read, every
+    // variable slot is bound, calls match their function's arity and the result is defined.
+    // Otherwise returns what is wrong.
+    static const char* verify(const std::vector<Instruction>& instructions, int registerCount, int resultRegister, int variableCount, Arena& arena);
+};
@@ -7,6 +7,7 @@
 #include <map>
 #include <sstream>
 #include <memory>
+#include <algorithm>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "Calculator.h"
@@ -22,47 +23,12 @@
 #include "TokenList.h"
 #include "CalcError.h"
 #include "Functions.h"
+#include "Helper.h"
 #include "Instruction.h"
 #include "InstructionVM.h"
-#include "Helper.h"
+#include "RenderHelper.h"
 #include "Graph.h"
-
-void runTests() {
-    auto calculator = std::make_shared<Calculator>(false);
-
-    const std::vector<std::pair<std::string, double>> testCases = {
-        {"1+1", 2},
-        {"1.5 + 1.5", 3},
-        {"1.5 + -1.5", 0},
-        {"-1 + -2 + (-1 * 2)", -5.0},
-        {"0x0A + 10", 20},
-        {"0xFF + -0x0F", 240},
-        {"33-9+40-(30+15)", 19},
-        {"TAU + PI + (-PI + -TAU)", 0.},
-        {"max(1, max(1, 2))", 2.},
-        {"((1+1))", 2.},
-        {"+pi", M_PI},
-        {"-pi - -pi", 0},
-        {"sign(-pi)", -1},
-    };
-
-    int passes = 0;
-    for(auto &i : testCases) {
-        calculator->calculateInput(i.first);
-        calculator->compileInput(i.first);
-        double result = calculator->executeInstructions();
-
-        if(result != i.second || !calculator->resultIsValid()) {
-            std::cout << "Test case failed: '" << i.first << "', expected: " << i.second << ", got: " << result << std::endl;
-            calculator->setDebug(true);
-            calculator->calculateInput(i.first);
-            calculator->setDebug(false);
-        } else {
-            passes++;
-        }
-    }
-    std::cout << "Tests passed " << passes << "/" << testCases.size() << std::endl;
-}
+#include "EvaluationWorker.h"
 
 GLFWwindow* createWindow(float w, float h) {
     GLFWwindow* window;
@@ -103,7 +69,8 @@ class InputEngine {
     InputEngine(GLFWwindow* window, Graph* graph) :buffer(""), window(window), graph(graph) {
         cursor = 0;
         lastInput = 0;
-        calculator = new Calculator(false);
+        // Wakes the render loop out of glfwWaitEventsTimeout when a result is ready
+        worker = new EvaluationWorker([]() { glfwPostEmptyEvent(); });
         result = 0;
         hasSuggestions = false;
         tokenStartOffset = 0;
@@ -119,7 +86,7 @@ class InputEngine {
     }
 
     ~InputEngine() {
-        delete calculator;
+        delete worker;
         delete graph;
     }
 
@@ -130,15 +97,15 @@ class InputEngine {
         cursorPairDepth = -1;
 
         int characterRunningCount = 0;
-        for(auto &i : calculator->parsed->list) {
-            if(cursor >= characterRunningCount && cursor <= characterRunningCount + i.getValue().length()) {
+        for(auto &i : worker->current().tokens.list) {
+            if(cursor >= characterRunningCount && cursor <= characterRunningCount + i.getLength()) {
                 cursorDepth = i.getDepth();
                 if(cursorDepth != 0) {
                     cursorPairDepth = i.getPairId();
                 }
                 break;
             }
-            characterRunningCount += i.getValue().length();
+            characterRunningCount += i.getLength();
         }
     }
 
@@ -185,6 +152,7 @@ class InputEngine {
     }
 
     void handleBackspace() {
+        resultInvalid = true;
         validateTextSelection();
         if(hasSelectedText) {
             buffer.erase(selectIndexStart, selectIndexEnd - selectIndexStart);
@@ -239,7 +207,6 @@ class InputEngine {
     }
 
     void handleControl(int key, int scancode, int action, int mods) {
-        resultInvalid = true;
         if(key == GLFW_KEY_LEFT_SHIFT && action == GLFW_PRESS) {
             //std::cout << "start text selection" << std::endl;
             startTextSelection();
@@ -303,6 +270,7 @@ class InputEngine {
 
             if(key == GLFW_KEY_TAB) {
                 if(hasSuggestions) {
+                    resultInvalid = true;
                     int suggestionWidth = tokenEndOffset - tokenStartOffset;
                     buffer.erase(tokenStartOffset, suggestionWidth);
                     cursor = tokenStartOffset;
@@ -391,53 +359,42 @@ class InputEngine {
     }
 
     void tick() {
-        if(resultInvalid) {
-            calculator->calculateInput(buffer); //bad way to error check
+        // Submitting never waits on evaluation, the worker only takes the latest input
+        GraphSampler::AdaptiveSettings settings = graph->getSamplingSettings();
+        if(resultInvalid || !(settings == submittedSettings)) {
             resultInvalid = false;
-            if(calculator->resultIsValid()) {
-                calculator->vm->reset();
-                calculator->compileInput(buffer);
-                result = calculator->executeInstructions();
-
-                if(calculator->resultIsValid() && calculator->isGraph) {
-                    calculator->vm->reset();
-                    std::vector<float> points;            
-                    float sX = -1.;
-                    float eX = 1.;
-                    float steps = 800.;
-                    float stepSize = (eX * 2) / steps;
-                    for(float x = sX; x <= eX; x += stepSize) {
-                        calculator->vm->setVar("x", x);
-                        points.push_back(x); //x
-                        points.push_back(-calculator->executeInstructions()); //y
-                        points.push_back(0); //z
-                        points.push_back(0); //s
-                        points.push_back(0); //t
-                    }
-                    graph->addData(points);
-                }
-            } else {
-                result = 0;
+            submittedSettings = settings;
+            worker->submit(buffer, settings);
+        }
+
+        if(worker->poll()) {
+            const Evaluation& evaluation = worker->current();
+            result = evaluation.valid ? evaluation.result : 0;
+            // Uploads only if the curve differs from the one shown
+            if(evaluation.hasCurve) {
+                graph->setSamples(evaluation.curveHash, evaluation.xs, evaluation.ys);
             }
+            validateCursor();
         }
         
         // std::cout << calculator->resultIsValid() << std::endl;
 
         int characterRunningCount = 0;
         hasSuggestions = false;
-        for(auto &i : calculator->parsed->list) {
-            if(i.isType(Token::TOKEN_IDENTIFIER) && !i.isResolved()) {
-                if(cursor >= characterRunningCount && cursor <= characterRunningCount + i.getValue().length()) {
-                    suggestions = calculator->getSuggestions(i.getValue());
+        const TokenList& tokens = worker->current().tokens;
+        for(auto &i : tokens.list) {
+            if(i.isType(Token::TOKEN_IDENTIFIER) && !i.isResolved(tokens.source)) {
+                if(cursor >= characterRunningCount && cursor <= characterRunningCount + i.getLength()) {
+                    suggestions = Calculator::getSuggestions(tokens.getValue(i));
                     if(suggestions.size() > 0) {
                         hasSuggestions = true;
                         tokenStartOffset = characterRunningCount;
-                        tokenEndOffset = characterRunningCount + i.getValue().length();
+                        tokenEndOffset = characterRunningCount + i.getLength();
                         break;
                     }
                 }
             }
-            characterRunningCount += i.getValue().length();
+            characterRunningCount += i.getLength();
         }
 
         if(!hasSuggestions) {
@@ -454,7 +411,8 @@ class InputEngine {
     int cursor;
     std::string buffer;
     float lastInput;
-    Calculator *calculator;
+    EvaluationWorker *worker;
+    GraphSampler::AdaptiveSettings submittedSettings;
     int tokenStartOffset;
     int tokenEndOffset;
     std::vector<std::string> suggestions;
@@ -475,7 +433,6 @@ class InputEngine {
 };
 
 int main() {
-    runTests();
     float width = 1280;
     float height = 480;
 
@@ -524,9 +481,9 @@ int main() {
 
     while (!glfwWindowShouldClose(window)) {
         if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            inputEngine->calculator->setDebug(true);
-            inputEngine->calculator->calculateInput(inputEngine->buffer);
-            inputEngine->calculator->dumpInstructions();
+            Calculator debugCalculator(true);
+            debugCalculator.compileInput(inputEngine->buffer);
+            debugCalculator.dumpInstructions();
 
             glfwSetWindowShouldClose(window, true);
             break;
@@ -537,6 +494,8 @@ int main() {
 
         inputEngine->tick();
         double result = inputEngine->getResult();
+        // The latest evaluation the worker published, it can trail the buffer by a few keystrokes
+        const Evaluation& evaluation = inputEngine->worker->current();
 
         glm::vec3 position = glm::vec3(6., 22., 0.);
         glm::vec3 origPos = position;
@@ -544,28 +503,28 @@ int main() {
         bool showErrors = true;
 
         if(inputEngine->hasSelectedText) {
-            selectRect->view = Helper::quadMat(origPos.x + inputEngine->selectIndexStart * sdfFontDisplay->getMonospaceAdvance(), origPos.y - 18., sdfFontDisplay->getMonospaceAdvance() * (inputEngine->selectIndexEnd - inputEngine->selectIndexStart), 22.);
+            selectRect->view = RenderHelper::quadMat(origPos.x + inputEngine->selectIndexStart * sdfFontDisplay->getMonospaceAdvance(), origPos.y - 18., sdfFontDisplay->getMonospaceAdvance() * (inputEngine->selectIndexEnd - inputEngine->selectIndexStart), 22.);
             selectRect->render(projection);
         }
 
         int characterRunningCount = 0;
-        for(auto &i : inputEngine->calculator->parsed->list) {
+        for(auto &i : evaluation.tokens.list) {
             if (i.isParenthesis() && i.getPairId() == inputEngine->cursorPairDepth) {
-                hintRect->view = Helper::quadMat(origPos.x + characterRunningCount * sdfFontDisplay->getMonospaceAdvance(), origPos.y - 18., sdfFontDisplay->getMonospaceAdvance(), 22.);
+                hintRect->view = RenderHelper::quadMat(origPos.x + characterRunningCount * sdfFontDisplay->getMonospaceAdvance(), origPos.y - 18., sdfFontDisplay->getMonospaceAdvance(), 22.);
                 hintRect->render(projection);
             }
 
             float w = 0;
             sdfFontDisplay->renderTextSimple(
                 position,
-                i.getColor(), 
-                i.getValue(),
+                RenderHelper::tokenColor(i, evaluation.tokens.source), 
+                evaluation.tokens.getValue(i),
                 w,
                 (i.isParenthesis() && i.getPairId() == inputEngine->cursorPairDepth) ? 0.97 : 1,
                 0
             );
             position.x += w;
-            characterRunningCount += i.getValue().length();
+            characterRunningCount += i.getLength();
         }
 
         bool cursorState = (sin(time * 5.) > 0.) || ((glfwGetTime() - inputEngine->lastInput) < .25);
@@ -580,35 +539,28 @@ int main() {
             0
         );
 
-        if(inputEngine->calculator->resultIsValid() && !inputEngine->calculator->isGraph) {
-            std::ostringstream resultStream;
-
-            resultStream << " = ";
-            if(result == (int)result) {
-                resultStream << (int)result;
-            } else {
-                resultStream << std::setprecision(std::numeric_limits<double>::digits10) << result;
-            }
+        if(evaluation.valid && !evaluation.isGraph) {
+            // Shortest round trip text, whole numbers print without a fraction
+            std::string resultText = " = " + Helper::toShortestString(result);
 
             float w = 0;
             sdfFontDisplay->renderTextSimple(
                 position, 
                 glm::vec4(.8, .8, .8, 1.), 
-                resultStream.str(),
+                resultText,
                 w,
                 1,
                 0
             );
         } else {
             if(inputEngine->buffer.length() > 0 && !inputEngine->hasSuggestions) {
-                auto errors = inputEngine->calculator->getErrors();
                 glm::vec3 position = origPos + glm::vec3(0., 22., 0.);
-                for(const auto &i : *errors) {
+                for(const auto &i : evaluation.errors) {
                     float w = 0;
                     sdfFontDisplay->renderTextSimple(
                         position, 
-                        i->getToken().getColor(), 
-                        i->getToken().getValue(),
+                        RenderHelper::tokenColor(i.token, i.value), 
+                        i.value,
                         w,
                         1,
                         0
@@ -616,7 +568,7 @@ int main() {
                     sdfFontDisplay->renderTextSimple(
                         position + glm::vec3(w + sdfFontDisplay->getMonospaceAdvance(), 0., 0.), 
                         glm::vec4(.8, .8, .8, 1.), 
-                        i->getMessage(),
+                        i.message,
                         w,
                         1,
                         0
@@ -635,7 +587,7 @@ int main() {
                 float lq = 0;
 
                 if(inputEngine->suggestionsCursor == index) {
-                    selectRect->view = Helper::quadMat(
+                    selectRect->view = RenderHelper::quadMat(
                         origPos.x + (sdfFontDisplay->getMonospaceAdvance() * inputEngine->tokenStartOffset), 
                         22. + yOff - 18., 
                         sdfFontDisplay->getMonospaceAdvance() * s.length(), 
@@ -659,18 +611,18 @@ int main() {
         }
 
         float widestString = 0;
-        if(inputEngine->calculator->resultIsValid()) {
-            for(auto &i : inputEngine->calculator->compiledInstructions) {
-                widestString = std::max(widestString, (sdfFontSmall->getMonospaceAdvance() * i.toString().length()) + sdfFontSmall->getMonospaceAdvance());
+        if(evaluation.valid) {
+            for(auto &i : evaluation.instructions) {
+                widestString = std::max(widestString, (sdfFontSmall->getMonospaceAdvance() * i.length()) + sdfFontSmall->getMonospaceAdvance());
             }
 
             float yOff = sdfFontSmall->size;
-            for(auto &i : inputEngine->calculator->compiledInstructions) {
+            for(auto &i : evaluation.instructions) {
                 float lq = 0;
                 sdfFontSmall->renderTextSimple(
                     glm::vec3(width - widestString, yOff, 0.), 
                     glm::vec4(.8, .8, .8, 1.),
-                    i.toString(),
+                    i,
                     lq,
                     1,
                     0
@@ -685,7 +637,7 @@ int main() {
             width - widestString - 2.,
             inputEngine->graph->getH());
 
-        if(inputEngine->calculator->resultIsValid() && inputEngine->calculator->isGraph) {
+        if(evaluation.valid && evaluation.isGraph) {
             inputEngine->graph->render(projection);
         }
 
@@ -695,16 +647,4 @@ int main() {
     }
 
     glfwTerminate();
-
-    // Calculator calculator(true);
-    // while(1) {
-    //     std::cout << ">> ";
-    //     std::string input = "";
-    //     std::getline(std::cin, input);
-    //     try {
-    //         std::cout << calculator.calculateInput(input) << std::endl;
-    //     } catch (std::runtime_error &e) {
-    //         std::cout << e.what() << std::endl;
-    //     }
-    // }
 }
\ No newline at end of file